@@ -0,0 +1,558 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "calibration.h"
+#include "MatchFeatures.h"
+#include "DepthEstimator.h"
+
+
+using namespace calib;
+
+
+const char* cmdOptions =
+"{ calib_path                           |                    ../data/calib/params.yml                         | path to calibrate params          }"
+"{ video                                |                                                                     | recorded stereo video (L+R)       }"
+"{ truth                                |                                                                     | ground truth of the video         }"
+"{ rectify                              |                                  1                                  | rectify recorded frames           }"
+"{ backends                             |                          features,bm,sgbm,ncc                       | depth backends to compare         }"
+"{ sizes                                |                               1,2,4,8,16                            | objects in synthetic sequences    }"
+"{ frames                               |                                  50                                 | frames per synthetic sequence     }"
+"{ width                                |                                 640                                 | synthetic view width              }"
+"{ height                               |                                 480                                 | synthetic view height             }"
+"{ seed                                 |                                  0                                  | random seed                       }"
+"{ csv                                  |                                                                     | path to write results (CSV)       }"
+"{ json                                 |                                                                     | path to write results (JSON)      }"
+"{ q ? help usage                       |                                                                     | print help message                }";
+
+
+// Calibration if params.yml is not available
+#define BENCH_BASELINE            0.06
+#define BENCH_FOCAL               700.0
+
+// Synthetic scene: disparity of the background and of objects
+#define SCENE_BG_DISPARITY        4
+#define SCENE_MIN_DISPARITY       20
+#define SCENE_MAX_DISPARITY       96
+#define SCENE_MIN_BOX             40
+#define SCENE_MAX_BOX             120
+#define SCENE_MAX_SPEED           4
+// Part of objects with weak texture (hard for keypoints)
+#define SCENE_TEXTURELESS_PROB    0.3
+
+
+
+//
+// Object of the frame with known distance
+struct ObjectTruth
+{
+	std::int32_t id;
+	cv::Rect box;
+	std::double_t distance;
+};
+
+//
+// Source of rectified stereo pairs (left | right) with ground truth
+class StereoSequence
+{
+public:
+	virtual ~StereoSequence() {}
+
+	virtual bool next(cv::Mat &frame, std::vector<ObjectTruth> &objects) = 0;
+};
+
+//
+// Textured objects over textured background of a rectified pair.
+// Right view is the left view shifted by the integer disparity of each object
+class SyntheticStereo : public StereoSequence
+{
+public:
+	SyntheticStereo(cv::Size size, std::int32_t nObjects, std::int32_t nFrames, std::double_t base, std::double_t focal, std::uint64_t seed);
+
+	virtual bool next(cv::Mat &frame, std::vector<ObjectTruth> &objects) override;
+
+private:
+	struct SceneObject
+	{
+		cv::Mat texture;
+		cv::Point2i pos, vel;
+		std::int32_t disparity;
+	};
+
+	cv::Size m_size;
+	std::int32_t m_frames, m_frame;
+	std::double_t m_base, m_focal;
+	cv::RNG m_rng;
+
+	cv::Mat m_background;
+	std::vector<SceneObject> m_objects;
+
+	cv::Mat createTexture(cv::Size size, bool isTextureless);
+};
+
+//
+// Recorded stereo video and its ground truth.
+// Truth file: "frame id x y width height distance" per line ('#' - comment)
+class RecordedStereo : public StereoSequence
+{
+public:
+	RecordedStereo(const std::string &videoPath, const std::string &truthPath, const StereoRectifier *rectifier);
+
+	bool isOpened() const { return m_cap.isOpened(); }
+	virtual bool next(cv::Mat &frame, std::vector<ObjectTruth> &objects) override;
+
+private:
+	cv::VideoCapture m_cap;
+	const StereoRectifier *m_rectifier;
+	std::int32_t m_frame;
+
+	std::map<std::int32_t, std::vector<ObjectTruth>> m_truth;
+};
+
+//
+// Result of one backend on one sequence
+struct BenchmarkResult
+{
+	std::string backend;
+	std::int32_t objects;
+	std::int32_t frames;
+
+	std::int64_t ticks;
+	std::int64_t boxes;
+	std::int64_t covered;
+	std::double_t absError, relError;
+
+	BenchmarkResult() :
+		objects(0),
+		frames(0),
+		ticks(0),
+		boxes(0),
+		covered(0),
+		absError(0),
+		relError(0)
+	{}
+
+	std::double_t usPerFrame() const	{ return frames ? ticks * 1e6 / cv::getTickFrequency() / frames : 0; }
+	std::double_t usPerObject() const	{ return boxes ? ticks * 1e6 / cv::getTickFrequency() / boxes : 0; }
+	std::double_t objectsPerSec() const	{ return ticks ? boxes * cv::getTickFrequency() / ticks : 0; }
+	std::double_t coverage() const		{ return boxes ? 100.0 * covered / boxes : 0; }
+	std::double_t meanAbsError() const	{ return covered ? absError / covered : 0; }
+	std::double_t meanRelError() const	{ return covered ? 100.0 * relError / covered : 0; }
+};
+
+
+std::vector<std::string> split(const std::string &str);
+bool parseBackend(const std::string &name, DepthMode &mode);
+
+BenchmarkResult runBackend(const std::string &name, StereoSequence &sequence, std::double_t base, std::double_t focal, bool isRectified);
+void computeFeatures(MatchFeatures &mf, const cv::Mat &frame, std::vector<TrackedObject> &tObjects, std::double_t base, std::double_t focal);
+
+void printResult(const BenchmarkResult &result);
+bool writeCsv(const std::string &path, const std::vector<BenchmarkResult> &results);
+bool writeJson(const std::string &path, const std::vector<BenchmarkResult> &results);
+
+
+int main(int argc, const char* argv[])
+{
+	cv::CommandLineParser parser(argc, argv, cmdOptions);
+
+	if (parser.has("help"))
+	{
+		parser.printMessage();
+		return -1;
+	}
+	if (!parser.check())
+	{
+		parser.printErrors();
+		return -1;
+	}
+
+	// Distance of objects depends on the baseline and focal length of the cameras
+	StereoCalibrationReader params(parser.get<std::string>("calib_path"));
+	std::double_t base = BENCH_BASELINE, focal = BENCH_FOCAL;
+	if (params.computeParams() && params.getBaseline() > 0 && params.getFocalLenght() > 0)
+	{
+		base = params.getBaseline();
+		focal = params.getFocalLenght();
+	}
+	else
+		std::cout << ">> Calibration is not read, default baseline and focal length are used" << std::endl;
+
+	std::vector<std::string> backends = split(parser.get<std::string>("backends"));
+	std::vector<BenchmarkResult> results;
+
+	std::cout << std::setw(10) << std::left << "backend" << std::right << std::setw(8) << "objects"
+		<< std::setw(12) << "us/frame" << std::setw(12) << "us/object" << std::setw(12) << "objects/s"
+		<< std::setw(10) << "coverage" << std::setw(12) << "abs error" << std::setw(12) << "rel error" << std::endl;
+
+	std::string videoPath = parser.get<std::string>("video");
+	if (!videoPath.empty())
+	{
+		// Recorded sequence (frames are rectified by the calibration if required)
+		StereoRectifier rectifier;
+		bool isRectified = parser.get<bool>("rectify") && rectifier.init(params);
+
+		if (!isRectified)
+			std::cout << ">> Frames are not rectified: dense backends are skipped, features are matched by brute force" << std::endl;
+
+		for (auto &backend : backends)
+		{
+			// Block matching and NCC search along rows of rectified frames only
+			DepthMode mode = DepthMode::DEPTH_FEATURES;
+			if (!isRectified && parseBackend(backend, mode) && mode != DepthMode::DEPTH_FEATURES)
+				continue;
+
+			RecordedStereo sequence(videoPath, parser.get<std::string>("truth"), isRectified ? &rectifier : nullptr);
+			if (!sequence.isOpened())
+			{
+				std::cout << ">> Failed to open " << videoPath << std::endl;
+				return -1;
+			}
+
+			results.push_back(runBackend(backend, sequence, base, focal, isRectified));
+			printResult(results.back());
+		}
+	}
+	else
+	{
+		// Synthetic sequences: throughput versus number of objects
+		cv::Size size(parser.get<std::int32_t>("width"), parser.get<std::int32_t>("height"));
+		std::int32_t frames = std::max(parser.get<std::int32_t>("frames"), 1);
+		std::uint64_t seed = parser.get<std::int32_t>("seed");
+
+		for (auto &sizeStr : split(parser.get<std::string>("sizes")))
+		{
+			std::int32_t nObjects = std::atoi(sizeStr.c_str());
+			if (nObjects <= 0)	continue;
+
+			for (auto &backend : backends)
+			{
+				// The same sequence for all backends
+				SyntheticStereo sequence(size, nObjects, frames, base, focal, seed);
+
+				results.push_back(runBackend(backend, sequence, base, focal, true));
+				printResult(results.back());
+			}
+		}
+	}
+
+	std::string csvPath = parser.get<std::string>("csv");
+	if (!csvPath.empty() && !writeCsv(csvPath, results))
+		std::cout << ">> Failed to write " << csvPath << std::endl;
+
+	std::string jsonPath = parser.get<std::string>("json");
+	if (!jsonPath.empty() && !writeJson(jsonPath, results))
+		std::cout << ">> Failed to write " << jsonPath << std::endl;
+
+	return 0;
+}
+
+//
+// Run the backend over the sequence.
+// Objects keep their smoothed distance between frames (as tracked objects in the application)
+BenchmarkResult runBackend(const std::string &name, StereoSequence &sequence, std::double_t base, std::double_t focal, bool isRectified)
+{
+	BenchmarkResult result;
+	result.backend = name;
+
+	DepthMode mode = DepthMode::DEPTH_FEATURES;
+	if (!parseBackend(name, mode))
+	{
+		std::cout << ">> Unknown backend " << name << std::endl;
+		return result;
+	}
+
+	DepthEstimator depthEstimator(base, focal, mode);
+	// Epipolar matcher searches along rows (rectified frames only)
+	MatchFeatures mf(FeatureDetectorType::DETECTOR_ORB, DescriptorExtractorType::EXTRACTOR_ORB,
+		isRectified ? MatcherType::MATCHER_EPIPOLAR : MatcherType::MATCHER_BRUTEFORCE);
+
+	std::map<std::int32_t, std::double_t> distAvg;
+
+	cv::Mat frame;
+	std::vector<ObjectTruth> objects;
+	while (sequence.next(frame, objects))
+	{
+		std::vector<TrackedObject> tObjects(objects.size());
+		for (std::size_t i = 0; i < objects.size(); i++)
+		{
+			tObjects[i].id_int = objects[i].id;
+			tObjects[i].id_ext = objects[i].id;
+			tObjects[i].box = objects[i].box;
+			tObjects[i].missed = 0;
+			tObjects[i].distance = -1;
+
+			auto it = distAvg.find(objects[i].id);
+			tObjects[i].distAvg = it != distAvg.end() ? it->second : -1;
+		}
+
+		std::int64_t start = cv::getTickCount();
+		if (mode == DepthMode::DEPTH_FEATURES)
+			computeFeatures(mf, frame, tObjects, base, focal);
+		else
+			depthEstimator.compute(frame, tObjects, 0);
+		result.ticks += cv::getTickCount() - start;
+
+		for (std::size_t i = 0; i < objects.size(); i++)
+		{
+			result.boxes++;
+			distAvg[objects[i].id] = tObjects[i].distAvg;
+
+			if (tObjects[i].distance <= 0)	continue;
+
+			std::double_t error = std::abs(tObjects[i].distance - objects[i].distance);
+			result.covered++;
+			result.absError += error;
+			result.relError += error / objects[i].distance;
+		}
+
+		result.objects = std::max(result.objects, std::int32_t(objects.size()));
+		result.frames++;
+	}
+
+	return result;
+}
+
+//
+// Feature backend (as CalcDistance of the application on rectified frames, the same minimum disparity)
+void computeFeatures(MatchFeatures &mf, const cv::Mat &frame, std::vector<TrackedObject> &tObjects, std::double_t base, std::double_t focal)
+{
+	cv::Rect left(0, 0, frame.cols / 2, frame.rows);
+	cv::Rect right(frame.cols / 2, 0, frame.cols / 2, frame.rows);
+
+	if (!mf.ComputeFrameFeatures(frame(left), frame(right)))	return;
+
+	for (auto &tObj : tObjects)
+	{
+		std::vector<cv::Point2f> pt1, pt2;
+		mf.getMatchedPoints(mf.MatchRegion(tObj.box), pt1, pt2);
+
+		DisparityModel model;
+		if (!MatchFeatures::estimateDisparity(pt1, pt2, tObj.box, model) || model.disparity <= DISPARITY_MIN_DISTANCE)	continue;
+
+		tObj.distance = calculateDistance(base, focal, model.disparity);
+		tObj.distAvg = tObj.distAvg != -1 ? (1.0 - TRACKER_DIST_ALPHA) * tObj.distAvg + TRACKER_DIST_ALPHA * tObj.distance : tObj.distance;
+	}
+}
+
+//
+// Synthetic rectified pairs
+SyntheticStereo::SyntheticStereo(cv::Size size, std::int32_t nObjects, std::int32_t nFrames, std::double_t base, std::double_t focal, std::uint64_t seed) :
+	m_size(size),
+	m_frames(nFrames),
+	m_frame(0),
+	m_base(base),
+	m_focal(focal),
+	m_rng(seed)
+{
+	// Background is far (small disparity)
+	m_background = createTexture(cv::Size(size.width + SCENE_BG_DISPARITY, size.height), false);
+
+	m_objects.resize(nObjects);
+	for (auto &obj : m_objects)
+	{
+		cv::Size boxSize(m_rng.uniform(SCENE_MIN_BOX, SCENE_MAX_BOX), m_rng.uniform(SCENE_MIN_BOX, SCENE_MAX_BOX));
+		obj.texture = createTexture(boxSize, m_rng.uniform(0.0, 1.0) < SCENE_TEXTURELESS_PROB);
+		obj.disparity = m_rng.uniform(SCENE_MIN_DISPARITY, SCENE_MAX_DISPARITY);
+		obj.pos = cv::Point2i(m_rng.uniform(obj.disparity, std::max(size.width - boxSize.width, obj.disparity + 1)),
+			m_rng.uniform(0, std::max(size.height - boxSize.height, 1)));
+		obj.vel = cv::Point2i(m_rng.uniform(-SCENE_MAX_SPEED, SCENE_MAX_SPEED + 1), m_rng.uniform(-SCENE_MAX_SPEED, SCENE_MAX_SPEED + 1));
+	}
+}
+
+//
+// Smoothed noise (strong texture) or smooth gradient with weak noise
+cv::Mat SyntheticStereo::createTexture(cv::Size size, bool isTextureless)
+{
+	cv::Mat texture(size, CV_8UC1);
+	m_rng.fill(texture, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+
+	if (isTextureless)
+	{
+		cv::GaussianBlur(texture, texture, cv::Size(0, 0), 8);
+		cv::normalize(texture, texture, 60, 190, cv::NORM_MINMAX);
+	}
+	else
+		cv::GaussianBlur(texture, texture, cv::Size(3, 3), 0);
+
+	return texture;
+}
+
+bool SyntheticStereo::next(cv::Mat &frame, std::vector<ObjectTruth> &objects)
+{
+	if (m_frame >= m_frames)	return false;
+
+	// right(x - d) = left(x)
+	cv::Mat left = m_background.colRange(0, m_size.width).clone();
+	cv::Mat right = m_background.colRange(SCENE_BG_DISPARITY, SCENE_BG_DISPARITY + m_size.width).clone();
+
+	objects.clear();
+	for (std::int32_t i = 0; i < std::int32_t(m_objects.size()); i++)
+	{
+		SceneObject &obj = m_objects[i];
+
+		// Bounce inside the view (the right box is inside too)
+		cv::Point2i pos = obj.pos + obj.vel;
+		if (pos.x < obj.disparity || pos.x + obj.texture.cols > m_size.width)	obj.vel.x = -obj.vel.x;
+		if (pos.y < 0 || pos.y + obj.texture.rows > m_size.height)				obj.vel.y = -obj.vel.y;
+		obj.pos += obj.vel;
+		obj.pos.x = std::min(std::max(obj.pos.x, obj.disparity), std::max(m_size.width - obj.texture.cols, obj.disparity));
+		obj.pos.y = std::min(std::max(obj.pos.y, 0), std::max(m_size.height - obj.texture.rows, 0));
+
+		cv::Rect box(obj.pos, obj.texture.size());
+		cv::Rect boxRight = box - cv::Point(obj.disparity, 0);
+		if ((box & cv::Rect(cv::Point(0, 0), m_size)) != box || (boxRight & cv::Rect(cv::Point(0, 0), m_size)) != boxRight)
+			continue;
+
+		obj.texture.copyTo(left(box));
+		obj.texture.copyTo(right(boxRight));
+
+		ObjectTruth truth;
+		truth.id = i;
+		truth.box = box;
+		truth.distance = calculateDistance(m_base, m_focal, obj.disparity);
+		objects.push_back(truth);
+	}
+
+	// Frames of the application are color
+	cv::Mat pair;
+	cv::hconcat(left, right, pair);
+	cv::cvtColor(pair, frame, cv::COLOR_GRAY2BGR);
+
+	m_frame++;
+
+	return true;
+}
+
+//
+// Recorded sequence
+RecordedStereo::RecordedStereo(const std::string &videoPath, const std::string &truthPath, const StereoRectifier *rectifier) :
+	m_cap(videoPath),
+	m_rectifier(rectifier),
+	m_frame(0)
+{
+	std::ifstream file(truthPath);
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')	continue;
+
+		std::istringstream stream(line);
+		std::int32_t frame;
+		ObjectTruth truth;
+		if (stream >> frame >> truth.id >> truth.box.x >> truth.box.y >> truth.box.width >> truth.box.height >> truth.distance)
+			m_truth[frame].push_back(truth);
+	}
+}
+
+bool RecordedStereo::next(cv::Mat &frame, std::vector<ObjectTruth> &objects)
+{
+	cv::Mat stereopair;
+	if (!m_cap.read(stereopair) || stereopair.empty())	return false;
+
+	if (m_rectifier)
+		m_rectifier->rectify(stereopair, frame);
+	else
+		frame = stereopair;
+
+	auto it = m_truth.find(m_frame++);
+	if (it != m_truth.end())
+		objects = it->second;
+	else
+		objects.clear();
+
+	return true;
+}
+
+//
+// Comma separated list
+std::vector<std::string> split(const std::string &str)
+{
+	std::vector<std::string> items;
+
+	std::istringstream stream(str);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+			items.push_back(item);
+	}
+
+	return items;
+}
+
+bool parseBackend(const std::string &name, DepthMode &mode)
+{
+	if (name == "features")
+		mode = DepthMode::DEPTH_FEATURES;
+	else if (name == "bm")
+		mode = DepthMode::DEPTH_BLOCK_MATCHING;
+	else if (name == "sgbm")
+		mode = DepthMode::DEPTH_SGBM;
+	else if (name == "ncc")
+		mode = DepthMode::DEPTH_TEMPLATE;
+	else
+		return false;
+
+	return true;
+}
+
+void printResult(const BenchmarkResult &result)
+{
+	std::cout << std::setw(10) << std::left << result.backend << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(8) << result.objects
+		<< std::setw(12) << result.usPerFrame()
+		<< std::setw(12) << result.usPerObject()
+		<< std::setw(12) << result.objectsPerSec()
+		<< std::setw(9) << result.coverage() << "%"
+		<< std::setw(12) << std::setprecision(4) << result.meanAbsError()
+		<< std::setw(11) << std::setprecision(2) << result.meanRelError() << "%" << std::endl;
+}
+
+//
+// One row per backend and sequence
+bool writeCsv(const std::string &path, const std::vector<BenchmarkResult> &results)
+{
+	std::ofstream file(path);
+	if (!file.is_open())	return false;
+
+	file << "backend,objects,frames,us_per_frame,us_per_object,objects_per_sec,coverage_pct,abs_error,rel_error_pct" << std::endl;
+	for (auto &result : results)
+	{
+		file << result.backend << ',' << result.objects << ',' << result.frames << ','
+			<< result.usPerFrame() << ',' << result.usPerObject() << ',' << result.objectsPerSec() << ','
+			<< result.coverage() << ',' << result.meanAbsError() << ',' << result.meanRelError() << std::endl;
+	}
+
+	return true;
+}
+
+bool writeJson(const std::string &path, const std::vector<BenchmarkResult> &results)
+{
+	std::ofstream file(path);
+	if (!file.is_open())	return false;
+
+	file << "[" << std::endl;
+	for (std::size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult &result = results[i];
+
+		file << "  { \"backend\": \"" << result.backend << "\", \"objects\": " << result.objects << ", \"frames\": " << result.frames
+			<< ", \"us_per_frame\": " << result.usPerFrame() << ", \"us_per_object\": " << result.usPerObject()
+			<< ", \"objects_per_sec\": " << result.objectsPerSec() << ", \"coverage_pct\": " << result.coverage()
+			<< ", \"abs_error\": " << result.meanAbsError() << ", \"rel_error_pct\": " << result.meanRelError() << " }"
+			<< (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	file << "]" << std::endl;
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/flann.hpp>
+
+#include "MatchFeatures.h"
+
+
+const char* cmdOptions =
+"{ query                                |                                 500                                 | number of query descriptors       }"
+"{ train                                |                                 1000                                | number of train descriptors       }"
+"{ length                               |                                  32                                 | descriptor length (bytes)         }"
+"{ noise                                |                                  10                                 | flipped bits of true matches      }"
+"{ iterations                           |                                  20                                 | number of runs                    }"
+"{ q ? help usage                       |                                                                     | print help message                }";
+
+
+
+//
+// Result of one matcher
+struct BenchmarkResult
+{
+	std::string name;
+	std::double_t usPerQuery;
+	std::vector<cv::DMatch> matches;
+};
+
+
+void createDescriptors(std::int32_t nQuery, std::int32_t nTrain, std::int32_t length, std::int32_t noise,
+	cv::Mat &query, cv::Mat &train, std::vector<std::int32_t> &truth);
+std::vector<cv::DMatch> ratioTest(const std::vector<std::vector<cv::DMatch>> &knn_matches, std::float_t ratioThresh);
+void printResult(const BenchmarkResult &result, const std::vector<std::int32_t> &truth, const std::vector<cv::DMatch> &reference);
+
+
+int main(int argc, const char* argv[])
+{
+	cv::CommandLineParser parser(argc, argv, cmdOptions);
+
+	if (parser.has("help"))
+	{
+		parser.printMessage();
+		return -1;
+	}
+	if (!parser.check())
+	{
+		parser.printErrors();
+		return -1;
+	}
+
+	std::int32_t nQuery = parser.get<std::int32_t>("query");
+	std::int32_t nTrain = parser.get<std::int32_t>("train");
+	std::int32_t length = parser.get<std::int32_t>("length");
+	std::int32_t noise = parser.get<std::int32_t>("noise");
+	std::int32_t iterations = std::max(parser.get<std::int32_t>("iterations"), 1);
+
+	cv::Mat query, train;
+	std::vector<std::int32_t> truth;
+	createDescriptors(nQuery, nTrain, length, noise, query, train, truth);
+
+	const std::double_t usPerTick = 1e6 / cv::getTickFrequency() / iterations / nQuery;
+
+	std::vector<BenchmarkResult> results;
+
+	// Brute force (knnMatch + ratio test)
+	{
+		BenchmarkResult result;
+		result.name = "BFMatcher";
+
+		cv::Ptr<cv::BFMatcher> matcher = cv::BFMatcher::create(cv::NORM_HAMMING, false);
+
+		std::int64_t start = cv::getTickCount();
+		for (std::int32_t i = 0; i < iterations; i++)
+		{
+			std::vector<std::vector<cv::DMatch>> knn_matches;
+			matcher->knnMatch(query, train, knn_matches, 2);
+			result.matches = ratioTest(knn_matches, MATCH_RATIO_THRESH);
+		}
+		result.usPerQuery = (cv::getTickCount() - start) * usPerTick;
+
+		results.push_back(result);
+	}
+
+	// FLANN LSH (index is built once)
+	{
+		BenchmarkResult result;
+		result.name = "FLANN LSH";
+
+		cv::FlannBasedMatcher matcher(cv::makePtr<cv::flann::LshIndexParams>(12, 20, 2));
+		matcher.add(std::vector<cv::Mat>(1, train));
+		matcher.train();
+
+		std::int64_t start = cv::getTickCount();
+		for (std::int32_t i = 0; i < iterations; i++)
+		{
+			std::vector<std::vector<cv::DMatch>> knn_matches;
+			matcher.knnMatch(query, knn_matches, 2);
+			result.matches = ratioTest(knn_matches, MATCH_RATIO_THRESH);
+		}
+		result.usPerQuery = (cv::getTickCount() - start) * usPerTick;
+
+		results.push_back(result);
+	}
+
+	// Popcount with fused ratio test
+	{
+		BenchmarkResult result;
+		result.name = std::string("Hamming ") + HammingMatcher::getBackendName();
+
+		HammingMatcher matcher(MATCH_RATIO_THRESH);
+		matcher.train(train);
+
+		std::int64_t start = cv::getTickCount();
+		for (std::int32_t i = 0; i < iterations; i++)
+			matcher.match(query, result.matches);
+		result.usPerQuery = (cv::getTickCount() - start) * usPerTick;
+
+		results.push_back(result);
+	}
+
+	std::cout << ">> Query: " << nQuery << ", train: " << nTrain << ", length: " << length << " bytes" << std::endl << std::endl;
+	std::cout << std::setw(16) << std::left << "matcher" << std::right << std::setw(12) << "us/query"
+		<< std::setw(10) << "matches" << std::setw(10) << "correct" << std::setw(12) << "same as BF" << std::endl;
+
+	for (auto &result : results)
+		printResult(result, truth, results[0].matches);
+
+	return 0;
+}
+
+//
+// Random train descriptors, part of queries are noisy copies of train descriptors
+void createDescriptors(std::int32_t nQuery, std::int32_t nTrain, std::int32_t length, std::int32_t noise,
+	cv::Mat &query, cv::Mat &train, std::vector<std::int32_t> &truth)
+{
+	cv::RNG rng(0);
+
+	train.create(nTrain, length, CV_8UC1);
+	query.create(nQuery, length, CV_8UC1);
+	rng.fill(train, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+	rng.fill(query, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+
+	truth.assign(nQuery, -1);
+	for (std::int32_t i = 0; i < nQuery; i++)
+	{
+		// Half of queries have a true match
+		if (i % 2)	continue;
+
+		truth[i] = rng.uniform(0, nTrain);
+		train.row(truth[i]).copyTo(query.row(i));
+
+		for (std::int32_t j = 0; j < noise; j++)
+		{
+			std::int32_t bit = rng.uniform(0, length * 8);
+			query.at<std::uint8_t>(i, bit / 8) ^= std::uint8_t(1 << (bit % 8));
+		}
+	}
+}
+
+//
+// Lowe's ratio test (as in MatchFeatures)
+std::vector<cv::DMatch> ratioTest(const std::vector<std::vector<cv::DMatch>> &knn_matches, std::float_t ratioThresh)
+{
+	std::vector<cv::DMatch> good_matches;
+	for (auto &knn : knn_matches)
+	{
+		if (knn.size() > 1 && knn[0].distance < ratioThresh * knn[1].distance)
+			good_matches.push_back(knn[0]);
+	}
+
+	return good_matches;
+}
+
+void printResult(const BenchmarkResult &result, const std::vector<std::int32_t> &truth, const std::vector<cv::DMatch> &reference)
+{
+	std::int32_t correct = 0, same = 0;
+
+	for (auto &match : result.matches)
+	{
+		if (truth[match.queryIdx] == match.trainIdx)
+			correct++;
+
+		for (auto &ref : reference)
+		{
+			if (ref.queryIdx == match.queryIdx && ref.trainIdx == match.trainIdx)
+			{
+				same++;
+				break;
+			}
+		}
+	}
+
+	std::cout << std::setw(16) << std::left << result.name << std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << result.usPerQuery
+		<< std::setw(10) << result.matches.size()
+		<< std::setw(10) << correct
+		<< std::setw(12) << same << std::endl;
+}
\ No newline at end of file
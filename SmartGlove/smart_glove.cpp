@@ -8,9 +8,16 @@
 
 #include "DnnDetector.h"
 #include "TrackingByMatching.h"
+#include "TrackerCheckpoint.h"
+#include "DetectionLog.h"
 #include "calibration.h"
 #include "ControlDisplayedObjects.h"
 #include "MatchFeatures.h"
+#include "DepthEstimator.h"
+#include "StereoPointTracker.h"
+#include "PositionEstimator.h"
+#include "ProximityAlert.h"
+#include "DepthScheduler.h"
 
 
 using namespace calib;
@@ -28,6 +35,16 @@ const char* cmdOptions =
 "{ mean                                 |                        127.5 127.5 127.5 0                          | vector of mean model values       }"
 "{ swap                                 |                                  0                                  | swap R and B channels. TRUE|FALSE }"
 "{ writer_path                          |                              output.avi                             | path to output video			  }"
+"{ detect_rate                          |                                  1                                  | run detector every N-th frame     }"
+"{ tracker_state                        |                          tracker_state.bin                          | path to tracker state checkpoint  }"
+"{ tracker_params                       |                                                                     | path to tracker params (YAML)     }"
+"{ detections_log                       |                                                                     | path to record detections         }"
+"{ matcher                              |                                  bf                                 | matcher: bf|epipolar|hamming      }"
+"{ rectify                              |                                  0                                  | rectify frames by remap maps      }"
+"{ depth                                |                               features                              | depth: features|bm|sgbm|ncc       }"
+"{ track_points                         |                                  0                                  | track matched points by KLT       }"
+"{ alert_ttc                            |                                 2.0                                 | alert if time to contact less (s) }"
+"{ depth_budget                         |                                 10                                  | depth ms per frame (0 - no limit) }"
 "{ q ? help usage                       |                                                                     | print help message                }";
 
 
@@ -36,10 +53,27 @@ bool getFrame(cv::Mat &frame, cv::VideoCapture &cap1, cv::VideoCapture &cap2, st
 
 void runDetect(DnnDetector **m_detector, std::string modelPath, std::string configPath,
 	std::string labelPath, cv::Size size, std::double_t scale, cv::Scalar mean, bool swapRB);
-void runTrack(TrackingByMatching **tracker);
+void runTrack(TrackingByMatching **tracker, TrackerCheckpoint **checkpoint, std::string statePath);
 
-void CalcDistance(MatchFeatures &mf, cv::Mat &frame, std::vector<TrackedObject> &tObjects, std::double_t base,
-	std::double_t focalLenght, const cv::Mat *M, const cv::Mat *D, const cv::Mat *R, const cv::Mat *P);
+//
+// Depth of one object (computed in parallel, written back in order of objects)
+struct ObjectDepth
+{
+	bool isMatched;
+	std::double_t meanDx;
+	cv::Rect recRight;
+
+	ObjectDepth() :
+		isMatched(false),
+		meanDx(0)
+	{}
+};
+
+void CalcDistance(MatchFeatures &mf, std::vector<MatchContext> &contexts, StereoPointTracker *pointTracker, cv::Mat &frame,
+	FrameCache &cacheLeft, FrameCache &cacheRight, std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &visible,
+	std::double_t base, std::double_t focalLenght, const RectifyPointLut *luts, bool isRectified = false);
+ObjectDepth CalcObjectDepth(std::vector<cv::Point2f> pt1, std::vector<cv::Point2f> pt2, const cv::Rect &box,
+	const RectifyPointLut *luts, bool isRectified);
 
 void ControlObjects(ControlDisplayedObjects **controller, cv::Size imgSize, std::string classesPath);
 
@@ -50,6 +84,11 @@ void drawStat(cv::Mat &image, std::int32_t timeDetect, std::int32_t timeTracker,
 
 // Color Vector (for coloring areas)
 std::vector<cv::Scalar> colors;
+// Color of the object id (ids grow without limit across restarts)
+const cv::Scalar &getColor(std::int32_t id) { return colors[std::size_t(std::max(id, 0)) % colors.size()]; }
+
+// Tracker parameters (visibility of objects depends on them)
+TrackerParams trackerParams;
 
 //
 // Hot keys
@@ -57,6 +96,7 @@ void info()
 {
 	std::cout << "Press '0' to choose work with tracked objects\n" <<
 				 "Press '+' for sound prompt(NOT WORKS)\n"
+				 "Press 'd' to switch depth mode (features / bm / sgbm / ncc)\n"
 				 "Press ENTER to start m_detector and tracker\n" <<
 		         "Press SPACE to pause\n" <<
 		         "Press Esc to exit\n" << std::endl;
@@ -65,11 +105,12 @@ void info()
 int main(int argc, const char* argv[])
 {
 	// CommandLine
-	std::string videoPath, modelPath, configPath, labelPath, calibPath;
+	std::string videoPath, modelPath, configPath, labelPath, calibPath, statePath;
 	cv::Size size(0, 0);
 	std::double_t scale = 1.0;
 	cv::Scalar mean(0, 0, 0, 0);
 	bool swapRB = false;
+	std::int32_t detectRate = 1;
 
 	// Process input arguments
 	cv::CommandLineParser parser(argc, argv, cmdOptions);
@@ -96,10 +137,20 @@ int main(int argc, const char* argv[])
 	labelPath = parser.get <std::string>("label_path");
 
 	calibPath = parser.get <std::string>("calib_path");
+	statePath = parser.get <std::string>("tracker_state");
+
+	if (parser.has("tracker_params"))
+		trackerParams.read(parser.get<std::string>("tracker_params"));
+
+	// Detections for offline tuning of the tracker
+	DetectionLog detectionLog;
+	if (parser.has("detections_log"))
+		detectionLog.open(parser.get<std::string>("detections_log"));
 
 	scale = parser.get<std::double_t>("scale");
 	mean = parser.get<cv::Scalar>("mean");
 	swapRB = parser.get<bool>("swap");
+	detectRate = std::max(parser.get<std::int32_t>("detect_rate"), 1);
 
 
 	// Get random colors
@@ -119,27 +170,89 @@ int main(int argc, const char* argv[])
 	// Detector, tracker
 	DnnDetector *m_detector = nullptr, *detector2 = nullptr;
 	TrackingByMatching *tracker = nullptr, *tracker2 = nullptr;
+	TrackerCheckpoint *checkpoint = nullptr;
 
 	// Cameras params
 	StereoCalibrationReader params(calibPath);
 	params.computeParams();
-	cv::Mat M[2], D[2], R[2], P[2];
-	M[0] = params.getM1();
-	M[1] = params.getM2();
-	D[0] = params.getD1();
-	D[1] = params.getD2();
-	R[0] = params.getR1();
-	R[1] = params.getR2();
-	P[0] = params.getP1();
-	P[1] = params.getP2();
-
-	MatchFeatures mf;
+
+	// Matched points are rectified by the tables instead of undistortPoints
+	const RectifyPointLut luts[2] = { params.getPointLut1(), params.getPointLut2() };
+	if (luts[0].isInitialized() && luts[1].isInitialized())
+	{
+		for (std::int32_t i = 0; i < 2; i++)
+		{
+			// Every pixel of the view (between grid nodes, where the error of interpolation is)
+			RectifyLutAccuracy accuracy = luts[i].accuracy();
+			std::cout << ">> Point table " << i + 1 << " error (px) over " << accuracy.points << " pixels: mean " << accuracy.meanError
+				<< ", max " << accuracy.maxError << std::endl;
+		}
+	}
+	else
+		std::cout << ">> Point tables not received, matched points are not rectified" << std::endl;
+
+	// Depth: feature matching or dense disparity on row bands of boxes
+	DepthMode depthMode = DepthMode::DEPTH_FEATURES;
+	std::string depthName = parser.get<std::string>("depth");
+	if (depthName == "bm")
+		depthMode = DepthMode::DEPTH_BLOCK_MATCHING;
+	else if (depthName == "sgbm")
+		depthMode = DepthMode::DEPTH_SGBM;
+	else if (depthName == "ncc")
+		depthMode = DepthMode::DEPTH_TEMPLATE;
+
+	DepthEstimator depthEstimator(params.getBaseline(), params.getFocalLenght(), depthMode);
+	depthEstimator.setDistAlpha(trackerParams.distAlpha);
+
+	// Position of objects by reprojection of box centres (Q of rectification)
+	PositionEstimator positionEstimator(params.getQ());
+
+	// Objects for depth within the time budget of the frame
+	DepthScheduler depthScheduler(parser.get<std::double_t>("depth_budget"));
+
+	// Matcher: brute force, rows of rectified frames (epipolar) or popcount of binary descriptors
+	MatcherType matcherType = MatcherType::MATCHER_BRUTEFORCE;
+	std::string matcherName = parser.get<std::string>("matcher");
+	if (matcherName == "epipolar")
+		matcherType = MatcherType::MATCHER_EPIPOLAR;
+	else if (matcherName == "hamming")
+		matcherType = MatcherType::MATCHER_HAMMING;
+
+	// Rectification of frames (otherwise matched points are undistorted).
+	// Dense disparity and the epipolar matcher require rectified frames
+	StereoRectifier rectifier;
+	bool isRectified = (parser.get<bool>("rectify") || depthMode != DepthMode::DEPTH_FEATURES || matcherType == MatcherType::MATCHER_EPIPOLAR) &&
+		rectifier.init(params);
+	cv::Mat rectified;
+
+	if (matcherType == MatcherType::MATCHER_EPIPOLAR && !isRectified)
+	{
+		std::cout << ">> Frames are not rectified, brute force matcher is used instead of epipolar" << std::endl;
+		matcherType = MatcherType::MATCHER_BRUTEFORCE;
+	}
+
+	MatchFeatures mf(FeatureDetectorType::DETECTOR_ORB, DescriptorExtractorType::EXTRACTOR_ORB, matcherType);
+
+	// Matching contexts of threads (depth of objects is computed in parallel)
+	std::vector<MatchContext> matchContexts(std::max(cv::getNumThreads(), 1));
+
+	// Matched points are moved by optical flow, features are matched again if few points survive
+	StereoPointTracker pointTracker;
+	bool isTrackPoints = parser.get<bool>("track_points");
+
+	// Alerts of approaching objects are raised by the depth stage and played by the worker thread
+	ProximityAlert proximityAlert([](const AlertEvent &event)
+	{
+		std::cout << '\a' << ">> Alert: object " << event.id_ext << ", distance " << event.distance
+			<< ", time to contact " << event.ttc << " s" << std::endl;
+	}, parser.get<std::double_t>("alert_ttc"));
 
 	// ControlObjects
 	ControlDisplayedObjects *controller = nullptr;
 
 	std::int8_t key = NULL;
 	std::int8_t pause = 1;
+	std::uint32_t frameCounter = 0;
 
 	info();
 
@@ -152,30 +265,54 @@ int main(int argc, const char* argv[])
 
 		if (!getFrame(frame, cap1, cap2, videoPath))	
 			break;
+		std::int64_t captureTick = cv::getTickCount();
+
+		// Both views are remapped once per frame
+		if (isRectified)
+		{
+			rectifier.rectify(frame, rectified);
+			std::swap(frame, rectified);
+		}
 
 
 		cv::Rect left(0, 0, frame.size().width / 2, frame.size().height);
 		cv::Rect right(frame.size().width / 2, 0, frame.size().width / 2, frame.size().height);
+
+		// Grayscale and pyramids of views are computed once and shared by the tracker,
+		// point tracker and feature matching (released with the frame)
+		FrameCachePtr cacheLeft = std::make_shared<FrameCache>(frame(left), frameCounter);
+		FrameCachePtr cacheRight = std::make_shared<FrameCache>(frame(right), frameCounter);
 		
 		// Detector and tracker (initialization)
 		if (key == '\r')
 		{
 			runDetect(&m_detector, modelPath, configPath, labelPath, size, scale, mean, swapRB);
-			runTrack(&tracker);
+			runTrack(&tracker, &checkpoint, statePath);
+			pointTracker.clear();
 		}
 
 		// Detector
+		// Between detector runs objects are moved by the tracker (optical flow)
 		std::uint32_t timeD = clock();
-		if (m_detector)
+		bool isDetected = m_detector && frameCounter % detectRate == 0;
+		if (isDetected)
 			m_detector->Detect(frame(left), detected_objects);
 		timeD = clock() - timeD;
 
+		// Skipped frames are not logged (they are not misses of the detector)
+		if (isDetected)
+			detectionLog.write(detected_objects, std::int32_t(frameCounter));
+		frameCounter++;
+
 		// Tracker
 		std::uint32_t timeT = clock();
-		if (tracker && !detected_objects.empty())
-			tracked_objects = tracker->track(detected_objects);
+		if (tracker)
+			tracked_objects = tracker->track(detected_objects, *cacheLeft);
 		timeT = clock() - timeT;
 
+		if (tracker && checkpoint)
+			checkpoint->update(*tracker);
+
 		// --TODO Not works
 		// Playing voice prompt
 		if (key == '+')
@@ -187,6 +324,7 @@ int main(int argc, const char* argv[])
 		// Controller
 		std::vector<std::int32_t> desIds;
 		std::int32_t idNav = -1;
+		std::int32_t navTarget = -1;
 		if (controller)
 		{
 			//    
@@ -196,9 +334,10 @@ int main(int argc, const char* argv[])
 			//    
 			for (auto tObj : tracked_objects)
 			{
-				if (tObj.id_ext != -1 && tObj.class_id == idNav && tObj.missed < TRACKER_MIN_MISSED)
+				if (tObj.id_ext != -1 && tObj.class_id == idNav && tObj.missed < trackerParams.minMissed)
 				{
 					controller->setNavigationBox(tObj.box);
+					navTarget = tObj.id_ext;
 					break;
 				}
 				else
@@ -208,8 +347,32 @@ int main(int argc, const char* argv[])
 			}
 		}
 
-		// Distance
-		CalcDistance(mf, frame, tracked_objects, params.getBaseline(), params.getFocalLenght(), M, D, R, P);
+		// Distance (navigation target and the most stale / nearest objects within the budget)
+		std::vector<std::int32_t> visible;
+		for (std::int32_t i = 0; i < std::int32_t(tracked_objects.size()); i++)
+		{
+			if (tracked_objects[i].id_ext != -1 && tracked_objects[i].missed <= trackerParams.minMissed)
+				visible.push_back(i);
+		}
+		std::vector<std::int32_t> scheduled = depthScheduler.select(tracked_objects, visible, navTarget);
+
+		std::int64_t timeDepth = cv::getTickCount();
+		if (depthEstimator.getMode() == DepthMode::DEPTH_FEATURES || !isRectified)
+			CalcDistance(mf, matchContexts, isTrackPoints ? &pointTracker : nullptr, frame, *cacheLeft, *cacheRight, tracked_objects, scheduled,
+				params.getBaseline(), params.getFocalLenght(), luts, isRectified);
+		else
+			depthEstimator.compute(frame, tracked_objects, scheduled);
+		depthScheduler.report(std::int32_t(scheduled.size()), cv::getTickCount() - timeDepth);
+
+		// Batch of objects with disparity on the frame
+		positionEstimator.update(tracked_objects, cv::getTickCount() / cv::getTickFrequency());
+
+		// Alert before drawing and showing the frame
+		proximityAlert.check(tracked_objects, captureTick);
+
+		// Smoothed distance, position and depth search range depend on previous frames
+		if (tracker)
+			tracker->updateDistances(tracked_objects);
 
 		// Draw
 		cv::Mat frame_left = frame(left);
@@ -224,6 +387,27 @@ int main(int argc, const char* argv[])
 		key = cv::waitKey(pause);
 		if (key == 27)	break;
 		if (key == ' ')	pause *= -1;
+		if (key == 'd')
+		{
+			switch (depthEstimator.getMode())
+			{
+			case DepthMode::DEPTH_FEATURES:
+				depthEstimator.setMode(DepthMode::DEPTH_BLOCK_MATCHING);
+				break;
+			case DepthMode::DEPTH_BLOCK_MATCHING:
+				depthEstimator.setMode(DepthMode::DEPTH_SGBM);
+				break;
+			case DepthMode::DEPTH_SGBM:
+				depthEstimator.setMode(DepthMode::DEPTH_TEMPLATE);
+				break;
+			default:
+				depthEstimator.setMode(DepthMode::DEPTH_FEATURES);
+				break;
+			}
+
+			if (!isRectified && depthEstimator.getMode() != DepthMode::DEPTH_FEATURES)
+				isRectified = rectifier.init(params);
+		}
 		if (key == '0')
 		{
 			cv::Size imgSize;
@@ -245,8 +429,8 @@ int main(int argc, const char* argv[])
 	}
 	if (tracker)
 	{
-		delete tracker;
-		tracker = nullptr;
+		// Tracker state is saved for warm restart
+		runTrack(&tracker, &checkpoint, statePath);
 	}
 
 	if (detector2)
@@ -270,6 +454,16 @@ int main(int argc, const char* argv[])
 	cap2.release();
 	frame.release();
 
+	// Glass-to-alert latency
+	AlertLatency latency = proximityAlert.getLatency();
+	if (latency.alerts > 0 || latency.dropped > 0)
+	{
+		std::cout << ">> Alerts: " << latency.alerts << ", dropped: " << latency.dropped << std::endl
+			<< ">> Capture -> raise, ms: mean " << latency.meanRaise << ", max " << latency.maxRaise << std::endl
+			<< ">> Raise -> delivery, ms: mean " << latency.meanQueue << ", max " << latency.maxQueue << std::endl
+			<< ">> Capture -> delivery, ms: mean " << latency.meanTotal << ", max " << latency.maxTotal << std::endl;
+	}
+
 	cv::destroyAllWindows();
 
 	return 0;
@@ -334,6 +528,9 @@ void runDetect(DnnDetector **m_detector, std::string modelPath, std::string conf
 		(*m_detector)->setScale(scale);
 		(*m_detector)->setMean(mean);
 		(*m_detector)->setSwap(swapRB);
+
+		// Low-confidence detections are associated by tracker (second pass)
+		(*m_detector)->setConfidence(trackerParams.lowConfidence);
 	}
 	else
 	{
@@ -341,85 +538,172 @@ void runDetect(DnnDetector **m_detector, std::string modelPath, std::string conf
 		(*m_detector) = nullptr;
 	}
 }
-void runTrack(TrackingByMatching **tracker)
+void runTrack(TrackingByMatching **tracker, TrackerCheckpoint **checkpoint, std::string statePath)
 {
 	if (!(*tracker))
 	{
-		(*tracker) = new TrackingByMatching();
+		(*tracker) = new TrackingByMatching(trackerParams);
+
+		// Warm restart with the saved tracks
+		if (!statePath.empty())
+		{
+			if ((*tracker)->load(statePath))
+				std::cout << ">> Tracker state loaded: " << statePath << std::endl;
+
+			(*checkpoint) = new TrackerCheckpoint(statePath);
+		}
 	}
 	else
 	{
+		if (*checkpoint)
+		{
+			(*checkpoint)->flush(**tracker);
+
+			delete (*checkpoint);
+			(*checkpoint) = nullptr;
+		}
+
 		delete (*tracker);
 		(*tracker) = nullptr;
 	}
 }
 
 //
-// Match left and right frames. Calculate distance
-void CalcDistance(MatchFeatures &mf, cv::Mat &frame, std::vector<TrackedObject> &tObjects, std::double_t base,
-	std::double_t focalLenght, const cv::Mat *M, const cv::Mat *D, const cv::Mat *R, const cv::Mat *P)
+// Match left and right frames. Calculate distance of objects with given indexes.
+// With the point tracker only objects with few tracked points are matched
+void CalcDistance(MatchFeatures &mf, std::vector<MatchContext> &contexts, StereoPointTracker *pointTracker, cv::Mat &frame,
+	FrameCache &cacheLeft, FrameCache &cacheRight, std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &visible,
+	std::double_t base, std::double_t focalLenght, const RectifyPointLut *luts, bool isRectified)
 {
 	cv::Rect left(0, 0, frame.size().width / 2, frame.size().height);
 	cv::Rect right(frame.size().width / 2, 0, frame.size().width / 2, frame.size().height);
 
-	for (auto &tObj : tObjects)
+	// Points of objects tracked from the previous frame
+	std::vector<std::vector<cv::Point2f>> pts1(visible.size()), pts2(visible.size());
+	std::vector<std::uint8_t> isTracked(visible.size(), 0);
+	bool isMatchRequired = true;
+	if (pointTracker)
 	{
-		if (tObj.id_ext == -1 || tObj.missed > TRACKER_MIN_MISSED)	continue;
+		pointTracker->update(cacheLeft, cacheRight, tObjects);
 
+		isMatchRequired = false;
+		for (std::size_t i = 0; i < visible.size(); i++)
+		{
+			const TrackedObject &tObj = tObjects[visible[i]];
+			isTracked[i] = pointTracker->getPoints(tObj.id_int, tObj.box, pts1[i], pts2[i]);
+			isMatchRequired = isMatchRequired || !isTracked[i];
+		}
+	}
+	if (visible.empty() || contexts.empty())	return;
 
-		cv::Mat mask = cv::Mat::zeros(frame(left).size(), CV_8UC1);
-		mask(tObj.box).setTo(255);
-		cv::Mat dst;
-		mf.ComputeFeatures(frame(left), frame(right), dst, mask);
+	// Features of both views are computed once per frame
+	if (isMatchRequired && !mf.ComputeFrameFeatures(cacheLeft, cacheRight))	return;
 
-		std::vector<cv::Point2f> pt1, pt2;
-		mf.getMatchedPoints(pt1, pt2);
+	// Objects are split between stripes, each stripe has its own context
+	std::vector<ObjectDepth> depths(visible.size());
+	const std::int32_t nStripes = std::min(std::int32_t(contexts.size()), std::int32_t(visible.size()));
+
+	cv::parallel_for_(cv::Range(0, nStripes), [&](const cv::Range &range)
+	{
+		for (std::int32_t stripe = range.start; stripe < range.end; stripe++)
+		{
+			for (std::int32_t i = stripe; i < std::int32_t(visible.size()); i += nStripes)
+			{
+				const cv::Rect &box = tObjects[visible[i]].box;
+				if (!isTracked[i])
+					mf.getMatchedPoints(mf.MatchRegion(box, contexts[stripe]), pts1[i], pts2[i]);
 
-		// Caclulate right rectangle obj
-		cv::Point2f ptCentral(0, 0);
-		for (auto p : pt2)
-			ptCentral = cv::Point2f(ptCentral.x + p.x, ptCentral.y + p.y);
+				depths[i] = CalcObjectDepth(pts1[i], pts2[i], box, luts, isRectified);
+			}
+		}
+	}, nStripes);
 
-		ptCentral = cv::Point2f(ptCentral.x / pt2.size(), ptCentral.y / pt2.size());
-		cv::Rect recRight(ptCentral.x - tObj.box.width / 2, ptCentral.y - tObj.box.height / 2, tObj.box.width, tObj.box.height);
-		cv::rectangle(frame(right), recRight, colors[tObj.id_ext]);
+	// Matched points are tracked on next frames
+	if (pointTracker)
+	{
+		for (std::size_t i = 0; i < visible.size(); i++)
+		{
+			if (!isTracked[i])
+				pointTracker->setPoints(tObjects[visible[i]].id_int, pts1[i], pts2[i]);
+		}
+	}
 
-		// Get undistort pts
-		if (pt1.empty() || pt2.empty())	continue;
-		CV_Assert(pt1.size() == pt2.size());
-		cv::undistortPoints(pt1, pt1, M[0], D[0], R[0], P[0]);
-		cv::undistortPoints(pt2, pt2, M[1], D[1], R[1], P[1]);
+	// Results are written back in order of objects
+	for (std::int32_t i = 0; i < std::int32_t(visible.size()); i++)
+	{
+		TrackedObject &tObj = tObjects[visible[i]];
+		const ObjectDepth &depth = depths[i];
 
-		// Calculate mean dx
-		std::double_t meanDx = 0;
-		std::vector<cv::Point2f>::iterator it1 = pt1.begin(), it2 = pt2.begin();
-		for (; it1 != pt1.end(), it2 != pt2.end(); ++it1, ++it2)
+		// Time to contact is not kept without the new depth
+		if (!depth.isMatched)
 		{
-			if ((*it1).x > (*it2).x)
-			{
-				std::double_t dx = (*it1).x - (*it2).x;
-				meanDx += dx;
-			}
+			tObj.ttc = -1;
+			continue;
 		}
-		meanDx /= pt1.size();
+
+		cv::rectangle(frame(right), depth.recRight, getColor(tObj.id_ext));
 
 		// Set distance
-		if (meanDx > 18)
+		if (depth.meanDx > DISPARITY_MIN_DISTANCE)
 		{
-			tObj.distance = calculateDistance(base, focalLenght, meanDx);
+			tObj.disparity = depth.meanDx;
+			tObj.distance = calculateDistance(base, focalLenght, depth.meanDx);
+			tObj.distAge = 0;
 
 			if (tObj.distAvg != -1)
-				tObj.distAvg = 0.9 * tObj.distAvg + 0.1 * tObj.distance;
+				tObj.distAvg = (1.0 - trackerParams.distAlpha) * tObj.distAvg + trackerParams.distAlpha * tObj.distance;
 			else
 				tObj.distAvg = tObj.distance;
 		}
 		else
 		{
 			tObj.distance = -1;
+			tObj.disparity = -1;
+			tObj.ttc = -1;
 		}
 	}
 }
 
+//
+// Disparity of matched (or tracked) points of the box.
+// The right box and the distance are given by one robust model (wrong matches are outliers)
+ObjectDepth CalcObjectDepth(std::vector<cv::Point2f> pt1, std::vector<cv::Point2f> pt2, const cv::Rect &box,
+	const RectifyPointLut *luts, bool isRectified)
+{
+	ObjectDepth depth;
+
+	if (pt1.empty() || pt2.empty())	return depth;
+	CV_Assert(pt1.size() == pt2.size());
+
+	DisparityModel model;
+	if (!MatchFeatures::estimateDisparity(pt1, pt2, box, model))	return depth;
+
+	depth.recRight = model.box;
+	depth.isMatched = true;
+
+	// Points of rectified frame are used as is
+	// (as well as points without rectification tables: calibration is not received)
+	if (isRectified || !luts[0].isInitialized() || !luts[1].isInitialized())
+	{
+		depth.meanDx = model.disparity;
+		return depth;
+	}
+
+	// Get undistort pts, mean dx of inliers
+	luts[0].map(pt1, pt1);
+	luts[1].map(pt2, pt2);
+
+	std::double_t meanDx = 0;
+	for (std::size_t i = 0; i < pt1.size(); i++)
+	{
+		if (model.inliers[i])
+			meanDx += pt1[i].x - pt2[i].x;
+	}
+	depth.meanDx = meanDx / model.nInliers;
+
+	return depth;
+}
+
 //
 // Draw
 void drawObjects(cv::Mat &image, const std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &desIds, std::int32_t idNav)
@@ -427,7 +711,7 @@ void drawObjects(cv::Mat &image, const std::vector<TrackedObject> &tObjects, con
 	for (auto &tObj : tObjects)
 	{
 		//        
-		if (tObj.id_ext != -1 && tObj.missed < TRACKER_MIN_MISSED)
+		if (tObj.id_ext != -1 && tObj.missed < trackerParams.minMissed)
 		{
 			//     
 			if (desIds.empty())
@@ -461,14 +745,14 @@ void drawObjects(cv::Mat &image, const std::vector<TrackedObject> &tObjects, con
 }
 void drawObject(cv::Mat &image, const TrackedObject &tracked_object)
 {
-	cv::rectangle(image, tracked_object.box, colors[tracked_object.id_ext]);
-	cv::circle(image, tracked_object.cm, 4, colors[tracked_object.id_ext], 1, 8, 0);
+	cv::rectangle(image, tracked_object.box, getColor(tracked_object.id_ext));
+	cv::circle(image, tracked_object.cm, 4, getColor(tracked_object.id_ext), 1, 8, 0);
 
 	cv::Point2d pt;
 	std::string text;
 	std::int32_t fontFace = 1;
 	std::double_t fontScale = 0.7;
-	cv::Scalar color(colors[tracked_object.id_ext]);
+	cv::Scalar color(getColor(tracked_object.id_ext));
 	std::int32_t thickness = 1;
 	std::int32_t linetype = 1;
 
@@ -494,6 +778,15 @@ void drawObject(cv::Mat &image, const TrackedObject &tracked_object)
 		pt = cv::Point2d(tracked_object.box.x + tracked_object.box.width * 1.1, tracked_object.box.y + tracked_object.box.height * 0.4);
 		cv::putText(image, text, pt, fontFace, fontScale, color, thickness, linetype, false);
 	}
+
+	// Time to contact (approaching objects)
+	if (tracked_object.ttc != -1)
+	{
+		text = "TTC: " + std::to_string(tracked_object.ttc);
+
+		pt = cv::Point2d(tracked_object.box.x + tracked_object.box.width * 1.1, tracked_object.box.y + tracked_object.box.height * 0.6);
+		cv::putText(image, text, pt, fontFace, fontScale, color, thickness, linetype, false);
+	}
 }
 void drawStat(cv::Mat &image, std::int32_t timeDetect, std::int32_t timeTracker, std::int32_t numberOfObjects, std::int32_t idNavigation, std::vector<std::int32_t> idDes)
 {
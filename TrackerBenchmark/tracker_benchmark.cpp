@@ -0,0 +1,234 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <atomic>
+#include <random>
+#include <cstdlib>
+#include <new>
+
+#include <opencv2/core.hpp>
+
+#include "TrackingByMatching.h"
+
+
+const char* cmdOptions =
+"{ sizes                                |                         10,100,1000,10000                           | objects in synthetic streams      }"
+"{ frames                               |                                 200                                 | max frames per stream             }"
+"{ budget                               |                               200000                                | max objects * frames per stream   }"
+"{ seed                                 |                                  0                                  | random seed                       }"
+"{ q ? help usage                       |                                                                     | print help message                }";
+
+
+#define STREAM_CLASSES        5
+#define STREAM_BOX_SIZE       40
+#define STREAM_FIELD_SCALE    150
+#define STREAM_MAX_SPEED      5.0
+#define STREAM_JITTER         2
+#define STREAM_DEATH_PROB     0.01
+#define STREAM_OCCLUSION_PROB 0.02
+#define STREAM_MAX_OCCLUSION  10
+#define STREAM_CLASS_NOISE    0.05
+#define STREAM_MIN_FRAMES     10
+
+
+
+// Counter of heap allocations (all threads)
+static std::atomic<std::int64_t> allocations(0);
+
+void* operator new(std::size_t size)
+{
+	allocations++;
+
+	if (void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept					{ std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept	{ std::free(ptr); }
+
+
+
+//
+// Synthetic detections: random walks, births and deaths,
+// occlusions (no detections for several frames) and class noise
+class SyntheticStream
+{
+public:
+	SyntheticStream(std::int32_t nObjects, std::uint32_t seed) :
+		m_rng(seed),
+		m_field(STREAM_FIELD_SCALE * std::sqrt(std::double_t(nObjects)))
+	{
+		m_objects.resize(nObjects);
+		for (auto &obj : m_objects)
+			birth(obj);
+	}
+
+	std::vector<DetectedObject> next();
+
+private:
+	struct SyntheticObject
+	{
+		cv::Point2d pos, vel;
+		std::int32_t class_id;
+		std::int32_t occluded;
+	};
+
+	std::mt19937 m_rng;
+	std::double_t m_field;
+	std::vector<SyntheticObject> m_objects;
+
+	void birth(SyntheticObject &obj);
+
+	std::double_t uniform(std::double_t a, std::double_t b) { return std::uniform_real_distribution<std::double_t>(a, b)(m_rng); }
+	std::int32_t uniformInt(std::int32_t a, std::int32_t b) { return std::uniform_int_distribution<std::int32_t>(a, b)(m_rng); }
+};
+
+void SyntheticStream::birth(SyntheticObject &obj)
+{
+	obj.pos = cv::Point2d(uniform(0, m_field), uniform(0, m_field));
+	obj.vel = cv::Point2d(uniform(-1, 1), uniform(-1, 1));
+	obj.class_id = uniformInt(0, STREAM_CLASSES - 1);
+	obj.occluded = 0;
+}
+
+std::vector<DetectedObject> SyntheticStream::next()
+{
+	static const char* classnames[STREAM_CLASSES] = { "person", "car", "bicycle", "dog", "chair" };
+
+	std::vector<DetectedObject> objects;
+
+	for (auto &obj : m_objects)
+	{
+		// Death (and birth of a new object instead)
+		if (uniform(0, 1) < STREAM_DEATH_PROB)
+			birth(obj);
+
+		// Random walk inside the field
+		obj.vel += cv::Point2d(uniform(-1, 1), uniform(-1, 1));
+		obj.vel.x = std::max(std::min(obj.vel.x, STREAM_MAX_SPEED), -STREAM_MAX_SPEED);
+		obj.vel.y = std::max(std::min(obj.vel.y, STREAM_MAX_SPEED), -STREAM_MAX_SPEED);
+		obj.pos += obj.vel;
+
+		if (obj.pos.x < 0 || obj.pos.x > m_field)	obj.vel.x = -obj.vel.x;
+		if (obj.pos.y < 0 || obj.pos.y > m_field)	obj.vel.y = -obj.vel.y;
+
+		// Occlusion
+		if (obj.occluded > 0)
+		{
+			obj.occluded--;
+			continue;
+		}
+		if (uniform(0, 1) < STREAM_OCCLUSION_PROB)
+		{
+			obj.occluded = uniformInt(1, STREAM_MAX_OCCLUSION);
+			continue;
+		}
+
+		// Class noise
+		std::int32_t class_id = obj.class_id;
+		if (uniform(0, 1) < STREAM_CLASS_NOISE)
+			class_id = uniformInt(0, STREAM_CLASSES - 1);
+
+		cv::Rect box(cvRound(obj.pos.x) + uniformInt(-STREAM_JITTER, STREAM_JITTER),
+			cvRound(obj.pos.y) + uniformInt(-STREAM_JITTER, STREAM_JITTER),
+			STREAM_BOX_SIZE + uniformInt(-STREAM_JITTER, STREAM_JITTER),
+			STREAM_BOX_SIZE + uniformInt(-STREAM_JITTER, STREAM_JITTER));
+
+		objects.push_back(DetectedObject(class_id, classnames[class_id], uniform(0.5, 1.0), box));
+	}
+
+	return objects;
+}
+
+
+std::vector<std::int32_t> parseSizes(const std::string &sizes);
+
+
+int main(int argc, const char* argv[])
+{
+	cv::CommandLineParser parser(argc, argv, cmdOptions);
+
+	if (parser.has("help"))
+	{
+		parser.printMessage();
+		return -1;
+	}
+	if (!parser.check())
+	{
+		parser.printErrors();
+		return -1;
+	}
+
+	std::vector<std::int32_t> sizes = parseSizes(parser.get<std::string>("sizes"));
+	std::int32_t maxFrames = parser.get<std::int32_t>("frames");
+	std::int32_t budget = parser.get<std::int32_t>("budget");
+	std::uint32_t seed = parser.get<std::uint32_t>("seed");
+
+	const std::double_t nsPerTick = 1e9 / cv::getTickFrequency();
+
+	std::cout << std::setw(8) << "objects" << std::setw(8) << "frames" << std::setw(10) << "tracked"
+		<< std::setw(12) << "track" << std::setw(12) << "match" << std::setw(12) << "repeat"
+		<< std::setw(12) << "missed" << std::setw(12) << "checkTr" << std::setw(14) << "allocs/frame" << std::endl;
+	std::cout << std::setw(26) << "" << "  (ns per object per frame)" << std::endl;
+
+	for (auto nObjects : sizes)
+	{
+		// Large streams are shorter (tracker is quadratic in objects)
+		std::int32_t nFrames = std::min(maxFrames, budget / nObjects);
+		nFrames = std::max(nFrames, STREAM_MIN_FRAMES);
+
+		// Stream is generated before timing
+		SyntheticStream stream(nObjects, seed);
+		std::vector<std::vector<DetectedObject>> frames(nFrames);
+		for (auto &objects : frames)
+			objects = stream.next();
+
+		TrackingByMatching tracker;
+		tracker.setProfiling(true);
+
+		std::int64_t allocs = 0;
+		for (auto &objects : frames)
+		{
+			std::int64_t before = allocations;
+			tracker.track(objects);
+			allocs += allocations - before;
+		}
+
+		const TrackerProfile &profile = tracker.getProfile();
+		std::double_t objectFrames = std::max<std::double_t>(profile.objects, 1);
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< std::setw(8) << nObjects
+			<< std::setw(8) << profile.frames
+			<< std::setw(10) << std::double_t(profile.objects) / profile.frames
+			<< std::setw(12) << profile.track * nsPerTick / objectFrames
+			<< std::setw(12) << profile.match * nsPerTick / objectFrames
+			<< std::setw(12) << profile.repeat * nsPerTick / objectFrames
+			<< std::setw(12) << profile.missed * nsPerTick / objectFrames
+			<< std::setw(12) << profile.tracked * nsPerTick / objectFrames
+			<< std::setw(14) << std::double_t(allocs) / profile.frames << std::endl;
+	}
+
+	return 0;
+}
+
+//
+// "10,100,1000" -> { 10, 100, 1000 }
+std::vector<std::int32_t> parseSizes(const std::string &sizes)
+{
+	std::vector<std::int32_t> values;
+	std::stringstream ss(sizes);
+	std::string item;
+
+	while (std::getline(ss, item, ','))
+	{
+		std::int32_t value = std::atoi(item.c_str());
+		if (value > 0)
+			values.push_back(value);
+	}
+
+	return values;
+}
\ No newline at end of file
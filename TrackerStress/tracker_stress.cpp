@@ -0,0 +1,290 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <random>
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+
+#include "TrackingByMatching.h"
+
+
+const char* cmdOptions =
+"{ trackers                             |                                  8                                  | trackers (one thread each)        }"
+"{ frames                               |                                 500                                 | frames per tracker                }"
+"{ objects                              |                                  50                                 | objects per frame                 }"
+"{ seed                                 |                                  0                                  | random seed                       }"
+"{ q ? help usage                       |                                                                     | print help message                }";
+
+
+#define STRESS_CLASSES     3
+#define STRESS_BOX_SIZE    30
+#define STRESS_FIELD_SIZE  1000
+#define STRESS_DEATH_PROB  0.05
+#define STRESS_MISS_PROB   0.1
+
+
+
+//
+// Ids of one tracker: all external and internal ids it has given out
+// and the number of ids given to two objects of one frame
+struct TrackerIds
+{
+	std::vector<std::int32_t> ext;
+	std::vector<std::int32_t> internal;
+	std::int32_t duplicates = 0;
+
+	bool operator==(const TrackerIds &other) const { return ext == other.ext && internal == other.internal; }
+};
+
+//
+// Detections of short-lived objects (many births, so many new ids)
+class StressStream
+{
+public:
+	StressStream(std::int32_t nObjects, std::uint32_t seed) :
+		m_rng(seed)
+	{
+		m_objects.resize(nObjects);
+		for (auto &box : m_objects)
+			birth(box);
+	}
+
+	std::vector<DetectedObject> next()
+	{
+		std::vector<DetectedObject> objects;
+
+		for (std::size_t i = 0; i < m_objects.size(); i++)
+		{
+			if (uniform() < STRESS_DEATH_PROB)
+				birth(m_objects[i]);
+			if (uniform() < STRESS_MISS_PROB)
+				continue;
+
+			m_objects[i].x += std::uniform_int_distribution<std::int32_t>(-2, 2)(m_rng);
+			m_objects[i].y += std::uniform_int_distribution<std::int32_t>(-2, 2)(m_rng);
+
+			std::int32_t class_id = std::int32_t(i % STRESS_CLASSES);
+			objects.push_back(DetectedObject(class_id, std::to_string(class_id), 0.9, m_objects[i]));
+		}
+
+		return objects;
+	}
+
+private:
+	std::mt19937 m_rng;
+	std::vector<cv::Rect> m_objects;
+
+	std::double_t uniform() { return std::uniform_real_distribution<std::double_t>(0, 1)(m_rng); }
+	void birth(cv::Rect &box)
+	{
+		std::uniform_int_distribution<std::int32_t> pos(0, STRESS_FIELD_SIZE);
+		box = cv::Rect(pos(m_rng), pos(m_rng), STRESS_BOX_SIZE, STRESS_BOX_SIZE);
+	}
+};
+
+
+void runTracker(TrackingByMatching &tracker, std::int32_t nObjects, std::int32_t nFrames, std::uint32_t seed, TrackerIds &ids);
+std::int32_t findCollisions(const std::vector<TrackerIds> &ids, bool isExternal);
+std::int32_t checkSharedAllocator(std::int32_t nTrackers, std::int32_t nObjects, std::int32_t nFrames, std::uint32_t seed);
+std::int32_t checkOwnCounters(std::int32_t nTrackers, std::int32_t nObjects, std::int32_t nFrames, std::uint32_t seed);
+
+
+//
+// Several trackers run in parallel threads (exit code 1 on collision):
+// - with the shared id allocator ids of different trackers must never be equal;
+// - without allocator each tracker gives ids from its own counter (as if it ran alone)
+int main(int argc, const char* argv[])
+{
+	cv::CommandLineParser parser(argc, argv, cmdOptions);
+
+	if (parser.has("help"))
+	{
+		parser.printMessage();
+		return -1;
+	}
+	if (!parser.check())
+	{
+		parser.printErrors();
+		return -1;
+	}
+
+	std::int32_t nTrackers = std::max(parser.get<std::int32_t>("trackers"), 2);
+	std::int32_t nFrames = std::max(parser.get<std::int32_t>("frames"), 1);
+	std::int32_t nObjects = std::max(parser.get<std::int32_t>("objects"), 1);
+	std::uint32_t seed = parser.get<std::uint32_t>("seed");
+
+	std::cout << ">> Trackers: " << nTrackers << ", frames: " << nFrames << ", objects: " << nObjects << std::endl;
+
+	std::int32_t collisions = checkSharedAllocator(nTrackers, nObjects, nFrames, seed) +
+		checkOwnCounters(nTrackers, nObjects, nFrames, seed);
+
+	if (collisions > 0)
+	{
+		std::cout << "FAILED: " << collisions << " collisions" << std::endl;
+		return 1;
+	}
+
+	std::cout << "OK: ids are unique" << std::endl;
+
+	return 0;
+}
+
+//
+// Trackers with the shared allocator: ids are unique among all trackers
+std::int32_t checkSharedAllocator(std::int32_t nTrackers, std::int32_t nObjects, std::int32_t nFrames, std::uint32_t seed)
+{
+	std::shared_ptr<TrackerIdAllocator> allocator = std::make_shared<TrackerIdAllocator>();
+	std::vector<TrackerIds> ids(nTrackers);
+
+	// Each thread owns its tracker and stream, only the allocator is shared
+	std::vector<std::thread> workers;
+	for (std::int32_t t = 0; t < nTrackers; t++)
+	{
+		workers.push_back(std::thread([&, t]()
+		{
+			TrackingByMatching tracker(allocator);
+			runTracker(tracker, nObjects, nFrames, seed + t, ids[t]);
+		}));
+	}
+	for (auto &worker : workers)
+		worker.join();
+
+	std::size_t nExt = 0, nInt = 0;
+	std::int32_t collisions = 0;
+	for (auto &trackerIds : ids)
+	{
+		nExt += trackerIds.ext.size();
+		nInt += trackerIds.internal.size();
+		collisions += trackerIds.duplicates;
+	}
+	std::cout << ">> Shared allocator. External ids: " << nExt << ", internal ids: " << nInt << std::endl;
+
+	collisions += findCollisions(ids, true) + findCollisions(ids, false);
+
+	// Counters of the allocator are above all given ids (saved in checkpoints)
+	for (auto &trackerIds : ids)
+	{
+		if ((!trackerIds.ext.empty() && trackerIds.ext.back() >= allocator->getExtId()) ||
+			(!trackerIds.internal.empty() && trackerIds.internal.back() >= allocator->getIntId()))
+		{
+			std::cout << "Allocator counters are behind the given ids" << std::endl;
+			collisions++;
+		}
+	}
+
+	return collisions;
+}
+
+//
+// Trackers without allocator: each tracker starts from its own counter (ids from 0)
+// and gives the same ids as the tracker of the same stream running alone
+std::int32_t checkOwnCounters(std::int32_t nTrackers, std::int32_t nObjects, std::int32_t nFrames, std::uint32_t seed)
+{
+	std::vector<TrackerIds> ids(nTrackers);
+
+	std::vector<std::thread> workers;
+	for (std::int32_t t = 0; t < nTrackers; t++)
+	{
+		workers.push_back(std::thread([&, t]()
+		{
+			TrackingByMatching tracker;
+			runTracker(tracker, nObjects, nFrames, seed + t, ids[t]);
+		}));
+	}
+	for (auto &worker : workers)
+		worker.join();
+
+	std::cout << ">> Own counters. External ids: " << ids[0].ext.size() << ", internal ids: " << ids[0].internal.size()
+		<< " (tracker 0)" << std::endl;
+
+	std::int32_t collisions = 0;
+	for (std::int32_t t = 0; t < nTrackers; t++)
+	{
+		collisions += ids[t].duplicates;
+
+		if ((!ids[t].ext.empty() && ids[t].ext.front() != 0) || (!ids[t].internal.empty() && ids[t].internal.front() != 0))
+		{
+			std::cout << "Tracker " << t << " does not start from its own counter" << std::endl;
+			collisions++;
+		}
+
+		// Reference: the same stream without concurrent trackers
+		TrackingByMatching tracker;
+		TrackerIds reference;
+		runTracker(tracker, nObjects, nFrames, seed + t, reference);
+		if (!(ids[t] == reference))
+		{
+			std::cout << "Tracker " << t << " ids depend on concurrent trackers" << std::endl;
+			collisions++;
+		}
+	}
+
+	return collisions;
+}
+
+//
+// Track the stream, collect ids given by the tracker
+void runTracker(TrackingByMatching &tracker, std::int32_t nObjects, std::int32_t nFrames, std::uint32_t seed, TrackerIds &ids)
+{
+	StressStream stream(nObjects, seed);
+
+	for (std::int32_t frame = 0; frame < nFrames; frame++)
+	{
+		std::vector<std::int32_t> frameExt, frameInt;
+		for (auto &tObj : tracker.track(stream.next()))
+		{
+			if (tObj.id_ext != -1)
+				frameExt.push_back(tObj.id_ext);
+			frameInt.push_back(tObj.id_int);
+		}
+
+		// Objects of one frame have different ids
+		for (auto values : { &frameExt, &frameInt })
+		{
+			std::sort(values->begin(), values->end());
+			auto last = std::unique(values->begin(), values->end());
+			ids.duplicates += std::int32_t(values->end() - last);
+			values->erase(last, values->end());
+		}
+
+		ids.ext.insert(ids.ext.end(), frameExt.begin(), frameExt.end());
+		ids.internal.insert(ids.internal.end(), frameInt.begin(), frameInt.end());
+	}
+
+	// Unique ids of the tracker
+	for (auto values : { &ids.ext, &ids.internal })
+	{
+		std::sort(values->begin(), values->end());
+		values->erase(std::unique(values->begin(), values->end()), values->end());
+	}
+}
+
+//
+// Id given out by more than one tracker
+std::int32_t findCollisions(const std::vector<TrackerIds> &ids, bool isExternal)
+{
+	std::map<std::int32_t, std::int32_t> owners;
+	std::int32_t collisions = 0;
+
+	for (std::int32_t t = 0; t < std::int32_t(ids.size()); t++)
+	{
+		for (auto id : isExternal ? ids[t].ext : ids[t].internal)
+		{
+			auto it = owners.find(id);
+			if (it == owners.end())
+			{
+				owners[id] = t;
+				continue;
+			}
+
+			if (collisions < 10)
+				std::cout << (isExternal ? "External" : "Internal") << " id " << id << ": trackers " << it->second << " and " << t << std::endl;
+			collisions++;
+		}
+	}
+
+	return collisions;
+}
\ No newline at end of file
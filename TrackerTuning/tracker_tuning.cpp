@@ -0,0 +1,310 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+
+#include "TrackingByMatching.h"
+#include "DetectionLog.h"
+
+
+const char* cmdOptions =
+"{ log                                  |                    ../data/logs/detections.txt                      | recorded detections               }"
+"{ output                               |                          tracker_params.yml                         | path to best params               }"
+"{ mode                                 |                                random                               | search mode: grid | random       }"
+"{ samples                              |                                 500                                 | number of random params sets      }"
+"{ threads                              |                                  0                                  | number of threads (0 - all cores) }"
+"{ switch_weight                        |                                 5.0                                 | score weight of id switches       }"
+"{ cost_weight                          |                                0.001                                | score weight of us per frame      }"
+"{ seed                                 |                                  0                                  | random seed                       }"
+"{ q ? help usage                       |                                                                     | print help message                }";
+
+
+
+//
+// Result of replaying the log with one params set
+struct TuningResult
+{
+	TrackerParams params;
+
+	// Part of detections covered by confirmed tracks
+	std::double_t coverage;
+	// Id changes of the same object between frames (per detection)
+	std::double_t switchRate;
+	// Tracker cost
+	std::double_t usPerFrame;
+	// Number of external ids
+	std::int32_t ids;
+
+	std::double_t score;
+
+	TuningResult() :
+		coverage(0.0),
+		switchRate(0.0),
+		usPerFrame(0.0),
+		ids(0),
+		score(-1e9)
+	{}
+};
+
+
+std::vector<TrackerParams> createGrid();
+std::vector<TrackerParams> createRandom(std::int32_t samples, std::uint32_t seed);
+TuningResult evaluate(const TrackerParams &params, const std::vector<std::vector<DetectedObject>> &frames,
+	std::double_t switchWeight, std::double_t costWeight);
+std::double_t getIoU(const cv::Rect &box1, const cv::Rect &box2);
+
+
+int main(int argc, const char* argv[])
+{
+	cv::CommandLineParser parser(argc, argv, cmdOptions);
+
+	if (parser.has("help"))
+	{
+		parser.printMessage();
+		return -1;
+	}
+	if (!parser.check())
+	{
+		parser.printErrors();
+		return -1;
+	}
+
+	std::string logPath = parser.get<std::string>("log");
+	std::string outputPath = parser.get<std::string>("output");
+	std::string mode = parser.get<std::string>("mode");
+	std::int32_t samples = parser.get<std::int32_t>("samples");
+	std::int32_t nThreads = parser.get<std::int32_t>("threads");
+	std::double_t switchWeight = parser.get<std::double_t>("switch_weight");
+	std::double_t costWeight = parser.get<std::double_t>("cost_weight");
+	std::uint32_t seed = parser.get<std::uint32_t>("seed");
+
+	// Recorded detections (only frames processed by the detector,
+	// the tracker is replayed without images, so skipped frames would be counted as misses)
+	std::vector<std::vector<DetectedObject>> frames;
+	if (!DetectionLog::read(logPath, frames) || frames.empty())
+	{
+		std::cout << "Detections not received" << std::endl;
+		return -1;
+	}
+	std::cout << ">> Detection frames: " << frames.size() << std::endl;
+
+	// Params sets
+	std::vector<TrackerParams> paramsSets;
+	if (mode == "grid")
+		paramsSets = createGrid();
+	else
+		paramsSets = createRandom(samples, seed);
+
+	// Default params are always checked
+	paramsSets.push_back(TrackerParams());
+
+	if (nThreads <= 0)
+		nThreads = std::max(std::int32_t(std::thread::hardware_concurrency()), 1);
+
+	std::cout << ">> Params sets: " << paramsSets.size() << ", threads: " << nThreads << std::endl;
+
+	// Each thread replays the log with its own tracker
+	std::vector<TuningResult> results(paramsSets.size());
+	std::atomic<std::size_t> next(0);
+
+	std::vector<std::thread> workers;
+	for (std::int32_t i = 0; i < nThreads; i++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			for (std::size_t idx = next++; idx < paramsSets.size(); idx = next++)
+				results[idx] = evaluate(paramsSets[idx], frames, switchWeight, costWeight);
+		}));
+	}
+	for (auto &worker : workers)
+		worker.join();
+
+	std::sort(results.begin(), results.end(), [](const TuningResult &r1, const TuningResult &r2) { return r1.score > r2.score; });
+
+	// Top results
+	std::cout << std::endl << "score\tcoverage\tswitches\tus/frame\tids" << std::endl;
+	for (std::size_t i = 0; i < std::min<std::size_t>(results.size(), 10); i++)
+	{
+		std::cout << results[i].score << "\t" << results[i].coverage << "\t" << results[i].switchRate << "\t"
+			<< results[i].usPerFrame << "\t" << results[i].ids << std::endl;
+	}
+
+	if (!results[0].params.write(outputPath))
+		return -1;
+
+	std::cout << std::endl << ">> Best params saved: " << outputPath << std::endl;
+
+	return 0;
+}
+
+//
+// Grid over the main thresholds
+std::vector<TrackerParams> createGrid()
+{
+	std::vector<TrackerParams> paramsSets;
+
+	for (std::double_t checkWeight : { 0.5, 0.6, 0.7, 0.8 })
+		for (std::double_t minCoverage : { 0.3, 0.45, 0.6 })
+			for (std::double_t maxEucDistance : { 50.0, 100.0, 150.0 })
+				for (std::int32_t minTracked : { 3, 5, 10, 20 })
+					for (std::int32_t maxMissed : { 30, 100, 200 })
+					{
+						TrackerParams params;
+						params.checkWeight = checkWeight;
+						params.minCoverage = minCoverage;
+						params.maxEucDistance = maxEucDistance;
+						params.minTracked = minTracked;
+						params.maxMissed = maxMissed;
+
+						paramsSets.push_back(params);
+					}
+
+	return paramsSets;
+}
+
+//
+// Random params sets (weights of checks are normalized to sum 1)
+std::vector<TrackerParams> createRandom(std::int32_t samples, std::uint32_t seed)
+{
+	std::vector<TrackerParams> paramsSets;
+	std::mt19937 rng(seed);
+
+	auto uniform = [&rng](std::double_t a, std::double_t b) { return std::uniform_real_distribution<std::double_t>(a, b)(rng); };
+	auto uniformInt = [&rng](std::int32_t a, std::int32_t b) { return std::uniform_int_distribution<std::int32_t>(a, b)(rng); };
+
+	for (std::int32_t i = 0; i < samples; i++)
+	{
+		TrackerParams params;
+
+		params.minAreasPercent = uniform(0.4, 0.9);
+		params.minCoverage = uniform(0.2, 0.8);
+		params.maxEucDistance = uniform(30.0, 200.0);
+		params.minConfidencePercent = uniform(0.5, 1.0);
+
+		params.weightArea = uniform(0.0, 1.0);
+		params.weightCoverage = uniform(0.0, 1.0);
+		params.weightEuc = uniform(0.0, 1.0);
+		params.weightConfidence = uniform(0.0, 1.0);
+		params.weightClassId = uniform(0.0, 1.0);
+
+		std::double_t sum = params.weightArea + params.weightCoverage + params.weightEuc + params.weightConfidence + params.weightClassId;
+		params.weightArea /= sum;
+		params.weightCoverage /= sum;
+		params.weightEuc /= sum;
+		params.weightConfidence /= sum;
+		params.weightClassId /= sum;
+
+		params.checkWeight = uniform(0.4, 0.9);
+
+		params.highConfidence = uniform(0.3, 0.8);
+		params.lowConfidence = uniform(0.05, params.highConfidence);
+
+		params.minTracked = uniformInt(2, 30);
+		params.maxMissed = uniformInt(10, 300);
+
+		paramsSets.push_back(params);
+	}
+
+	return paramsSets;
+}
+
+//
+// Replay the log and score the tracker.
+// The same object on consecutive frames is found by IoU of detections
+TuningResult evaluate(const TrackerParams &params, const std::vector<std::vector<DetectedObject>> &frames,
+	std::double_t switchWeight, std::double_t costWeight)
+{
+	TuningResult result;
+	result.params = params;
+
+	TrackingByMatching tracker(params);
+
+	std::vector<DetectedObject> prevObjects;
+	std::vector<std::int32_t> prevIds;
+	std::vector<std::int32_t> ids;
+	std::vector<std::int32_t> uniqueIds;
+
+	std::int64_t ticks = 0;
+	std::int64_t nDetections = 0, nCovered = 0, nSwitches = 0;
+
+	for (auto &objects : frames)
+	{
+		std::int64_t start = cv::getTickCount();
+		std::vector<TrackedObject> tracked = tracker.track(objects);
+		ticks += cv::getTickCount() - start;
+
+		if (objects.empty())	continue;
+
+		// External id of each detection (confirmed track updated on this frame)
+		ids.assign(objects.size(), -1);
+		for (std::size_t i = 0; i < objects.size(); i++)
+		{
+			std::double_t bestIoU = 0.5;
+			for (auto &tObj : tracked)
+			{
+				if (tObj.id_ext == -1 || tObj.missed != 0)	continue;
+
+				std::double_t iou = getIoU(objects[i].box, tObj.box);
+				if (iou > bestIoU)
+				{
+					bestIoU = iou;
+					ids[i] = tObj.id_ext;
+				}
+			}
+
+			if (ids[i] != -1)
+			{
+				nCovered++;
+				if (std::find(uniqueIds.begin(), uniqueIds.end(), ids[i]) == uniqueIds.end())
+					uniqueIds.push_back(ids[i]);
+			}
+		}
+
+		// Id switches of the same object
+		for (std::size_t i = 0; i < objects.size(); i++)
+		{
+			if (ids[i] == -1)	continue;
+
+			for (std::size_t j = 0; j < prevObjects.size(); j++)
+			{
+				if (prevIds[j] == -1 || prevObjects[j].class_id != objects[i].class_id)	continue;
+
+				if (getIoU(objects[i].box, prevObjects[j].box) > 0.5 && prevIds[j] != ids[i])
+				{
+					nSwitches++;
+					break;
+				}
+			}
+		}
+
+		nDetections += objects.size();
+		prevObjects = objects;
+		prevIds = ids;
+	}
+
+	if (nDetections == 0)	return result;
+
+	result.coverage = std::double_t(nCovered) / nDetections;
+	result.switchRate = std::double_t(nSwitches) / nDetections;
+	result.usPerFrame = 1e6 * ticks / cv::getTickFrequency() / frames.size();
+	result.ids = std::int32_t(uniqueIds.size());
+
+	result.score = result.coverage - switchWeight * result.switchRate - costWeight * result.usPerFrame;
+
+	return result;
+}
+
+//
+// Intersection over union
+std::double_t getIoU(const cv::Rect &box1, const cv::Rect &box2)
+{
+	std::double_t intersection = (box1 & box2).area();
+	std::double_t unionArea = box1.area() + box2.area() - intersection;
+
+	return unionArea > 0 ? intersection / unionArea : 0.0;
+}
\ No newline at end of file
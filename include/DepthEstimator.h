@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+
+#include "calib3d.hpp"
+#include "imgproc.hpp"
+
+#include "TrackingByMatching.h"
+
+
+// Disparity search range.
+// If the object distance is known, the range is bounded by it (+-margin)
+#define DEPTH_NUM_DISPARITIES   128
+#define DEPTH_DISPARITY_MARGIN  0.3
+
+#define DEPTH_BM_BLOCK_SIZE     15
+#define DEPTH_SGBM_BLOCK_SIZE   5
+
+// Minimum part of the box with valid disparity
+#define DEPTH_MIN_VALID_RATIO   0.1
+
+// Template matching: minimum correlation of the peak,
+// pyramid levels of the coarse search (template is not reduced below min size),
+// refinement window at the full resolution (+-pixels)
+#define DEPTH_NCC_MIN_SCORE     0.6
+#define DEPTH_NCC_MAX_LEVEL     2
+#define DEPTH_NCC_MIN_SIZE      16
+#define DEPTH_NCC_REFINE        2
+
+// Smoothing of distance (distAvg)
+#define DEPTH_DIST_ALPHA        TRACKER_DIST_ALPHA
+
+
+enum class DepthMode
+{
+	DEPTH_FEATURES,			// Feature matching (MatchFeatures)
+	DEPTH_BLOCK_MATCHING,	// StereoBM on the row band of the box
+	DEPTH_SGBM,				// StereoSGBM on the row band of the box
+	DEPTH_TEMPLATE			// NCC of the box along the same rows of the right view
+};
+
+
+
+//
+// Dense disparity of tracked objects.
+// Disparity is computed only on the rectified row bands covering the boxes
+// (overlapping boxes share one band), depth of the box is the median.
+// Template mode slides the whole box along the rows (works for textureless objects)
+class DepthEstimator
+{
+public:
+	DepthEstimator(std::double_t baseline, std::double_t focalLenght, DepthMode mode = DepthMode::DEPTH_BLOCK_MATCHING);
+	~DepthEstimator() {}
+
+	void setMode(DepthMode mode)	{ m_mode = mode; }
+	DepthMode getMode() const		{ return m_mode; }
+
+	void setDistAlpha(std::double_t alpha)	{ m_dist_alpha = alpha; }
+
+	// Frame - rectified stereo pair (left | right).
+	// Objects with id_ext and missed <= maxMissed are processed
+	void compute(const cv::Mat &frame, std::vector<TrackedObject> &tObjects, std::int32_t maxMissed);
+	// Only objects with given indexes are processed (DepthScheduler)
+	void compute(const cv::Mat &frame, std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &indexes);
+
+private:
+	//
+	// Rows of the frame covering several boxes
+	struct DepthBand
+	{
+		std::int32_t rowBegin, rowEnd;
+		std::int32_t colBegin, colEnd;
+		std::double_t minDisparity, maxDisparity;
+
+		// Indexes of objects
+		std::vector<std::int32_t> objects;
+	};
+
+	std::double_t m_baseline;
+	std::double_t m_focal_lenght;
+	DepthMode m_mode;
+	std::double_t m_dist_alpha;
+
+	cv::Ptr<cv::StereoBM> m_bm;
+	cv::Ptr<cv::StereoSGBM> m_sgbm;
+
+	void getDisparityRange(const TrackedObject &tObj, std::double_t &minDisparity, std::double_t &maxDisparity) const;
+
+	void computeTemplates(const cv::Mat &left, const cv::Mat &right, std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &indexes) const;
+	std::double_t matchTemplate(const cv::Mat &left, const cv::Mat &right, const cv::Rect &box,
+		std::double_t minDisparity, std::double_t maxDisparity) const;
+	std::double_t searchRow(const cv::Mat &strip, const cv::Mat &templ, std::int32_t &peak) const;
+
+	std::vector<DepthBand> createBands(const std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &indexes, cv::Size size) const;
+	void computeBand(const cv::Mat &left, const cv::Mat &right, const DepthBand &band, std::vector<TrackedObject> &tObjects);
+	// Range of the block matcher for the band (number of disparities is rounded up to 16)
+	void getMatcherRange(const DepthBand &band, std::int32_t &minDisparity, std::int32_t &numDisparities) const;
+	std::double_t getMedianDisparity(const cv::Mat &disparity, std::int32_t minDisparity) const;
+	void setDistance(TrackedObject &tObj, std::double_t disparity) const;
+};
\ No newline at end of file
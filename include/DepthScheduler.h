@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+
+#include "core.hpp"
+
+#include "TrackingByMatching.h"
+
+
+// Depth time of the frame (ms), 0 - not limited
+#define DEPTH_SCHED_BUDGET      10.0
+// Smoothing of the measured cost of one object
+#define DEPTH_SCHED_COST_ALPHA  0.2
+// Age of the distance never computed (frames)
+#define DEPTH_SCHED_NEVER_AGE   1000
+
+
+
+//
+// Selection of objects for the depth stage within the time budget of the frame.
+// The navigation target is always selected, other objects are ordered by
+// staleness of their distance weighted by proximity (served objects become fresh,
+// so equal objects are served in turn)
+class DepthScheduler
+{
+public:
+	DepthScheduler(std::double_t budgetMs = DEPTH_SCHED_BUDGET) :
+		m_budget(budgetMs),
+		m_cost(0)
+	{}
+	~DepthScheduler() {}
+
+	void setBudget(std::double_t budgetMs)	{ m_budget = budgetMs; }
+
+	// Indexes of visible objects to process on the frame.
+	// navTarget - external id of the navigation target (-1 if not set)
+	std::vector<std::int32_t> select(const std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &visible, std::int32_t navTarget) const;
+
+	// Measured time of the depth stage (cost model of the next frames)
+	void report(std::int32_t nObjects, std::int64_t ticks);
+
+	// Smoothed cost of one object (ms)
+	std::double_t getCost() const	{ return m_cost; }
+
+private:
+	std::double_t m_budget;
+	std::double_t m_cost;
+};
\ No newline at end of file
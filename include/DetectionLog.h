@@ -0,0 +1,39 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+#include "DnnDetector.h"
+
+
+
+// Recording of detected objects for offline replay
+// (tuning and benchmarks of the tracker without the detector).
+//
+// Only frames processed by the detector are written
+// (skipped frames are not misses of the detector).
+//
+// Text format:
+// frame <index> <number of objects>
+// <class_id> <confidence> <x> <y> <width> <height> <classname>
+class DetectionLog
+{
+public:
+	DetectionLog() {}
+	~DetectionLog() { close(); }
+
+	bool open(std::string filename);
+	void close();
+	bool isOpened() const { return m_out.is_open(); }
+
+	// Objects found by the detector on the frame (may be empty)
+	void write(const std::vector<DetectedObject> &objects, std::int32_t frame);
+
+	// Logged frames in order of writing (gaps of indexes are not filled)
+	static bool read(std::string filename, std::vector<std::vector<DetectedObject>> &frames,
+		std::vector<std::int32_t> *indexes = nullptr);
+
+private:
+	std::ofstream m_out;
+};
\ No newline at end of file
@@ -9,6 +9,12 @@
 #include <opencv2/highgui.hpp>
 
 
+// Detections below are dropped.
+// Tracker may use low-confidence detections, so the threshold is configurable
+#define DETECTOR_DEFAULT_CONFIDENCE 0.5
+
+
+
 enum class DetectorModel
 {
 	MOBILENET_SSD_V1,
@@ -44,6 +50,7 @@ public:
 		m_scale(1.0),
 		m_mean(0, 0, 0, 0),
 		m_swapRB(false),
+		m_confidence(DETECTOR_DEFAULT_CONFIDENCE),
 		m_path_model(pathToModel),
 		m_path_config(pathToConfig)
 	{}
@@ -60,6 +67,7 @@ public:
 	void setScale(std::double_t scale)	     { m_scale = 1 / scale; }
 	void setMean (cv::Scalar mean)		     { m_mean = mean; }
 	void setSwap (bool swap)			     { m_swapRB = swap; }
+	void setConfidence(std::double_t confidence) { m_confidence = confidence; }
 	void setModel(DetectorModel model)	     { m_model = model; }
 	void setLabel(std::string pathToLabel)   { m_path_label = pathToLabel; }
 	void setConfig(std::string pathToConfig) { m_path_config = pathToConfig; }
@@ -71,6 +79,7 @@ private:
 	std::double_t	m_scale;
 	cv::Scalar		m_mean;
 	bool			m_swapRB;
+	std::double_t	m_confidence;
 	cv::dnn::Net	m_net;
 
 	DetectorModel m_model;
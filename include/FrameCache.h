@@ -0,0 +1,53 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "core.hpp"
+#include "imgproc.hpp"
+#include "video.hpp"
+
+
+
+//
+// Image products of one frame (view): grayscale, optical flow pyramids, blurred grayscale.
+// Products are computed lazily on first request and shared by all stages and threads.
+// Returned references are valid while the cache exists (the frame is released with the last owner)
+class FrameCache
+{
+public:
+	FrameCache(const cv::Mat &frame, std::uint64_t id = 0) :
+		m_frame(frame),
+		m_id(id)
+	{}
+	~FrameCache() {}
+
+	const cv::Mat &getFrame() const	{ return m_frame; }
+	std::uint64_t getId() const		{ return m_id; }
+	cv::Size getSize() const		{ return m_frame.size(); }
+	bool empty() const				{ return m_frame.empty(); }
+
+	// Grayscale frame (the frame itself if it has one channel)
+	const cv::Mat &getGray();
+	// Pyramid for calcOpticalFlowPyrLK (with derivatives)
+	const std::vector<cv::Mat> &getPyramid(std::int32_t winSize, std::int32_t maxLevel);
+	// Grayscale smoothed by Gaussian kernel
+	const cv::Mat &getBlurred(std::int32_t kernelSize);
+
+private:
+	cv::Mat m_frame;
+	std::uint64_t m_id;
+
+	std::mutex m_mutex;
+
+	cv::Mat m_gray;
+	// Products by parameters (elements are not moved on insert)
+	std::map<std::pair<std::int32_t, std::int32_t>, std::vector<cv::Mat>> m_pyramids;
+	std::map<std::int32_t, cv::Mat> m_blurred;
+
+	const cv::Mat &gray();
+};
+
+typedef std::shared_ptr<FrameCache> FrameCachePtr;
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+#include "core.hpp"
+#include "features2d.hpp"
+
+
+//
+// Brute-force matcher of binary descriptors (ORB, BRIEF, ...).
+// Distances are computed by popcount (AVX2 / NEON / scalar),
+// two best distances are kept while scanning and the ratio test is fused.
+// No intermediate knn structures
+class HammingMatcher
+{
+public:
+	// Ratio test: best < ratio * second (MATCH_RATIO_THRESH of feature matching)
+	explicit HammingMatcher(std::float_t ratioThresh) :
+		m_ratio(ratioThresh)
+	{}
+	~HammingMatcher() {}
+
+	// Train descriptors (CV_8UC1, one per row)
+	void train(const cv::Mat &descriptors);
+	void clear()			{ m_train.release(); }
+	bool empty() const		{ return m_train.empty(); }
+
+	void setRatio(std::float_t ratioThresh) { m_ratio = ratioThresh; }
+
+	// Best match for each query descriptor passing the ratio test
+	void match(const cv::Mat &queryDescriptors, std::vector<cv::DMatch> &matches) const;
+	// Only given rows of query descriptors (queryIdx - row of queryDescriptors)
+	void match(const cv::Mat &queryDescriptors, const std::vector<std::int32_t> &queryIdxs, std::vector<cv::DMatch> &matches) const;
+
+	// Hamming distance between two descriptors of length bytes
+	static std::int32_t distance(const std::uint8_t *a, const std::uint8_t *b, std::int32_t length);
+
+	// AVX2, NEON or SCALAR
+	static const char* getBackendName();
+
+private:
+	cv::Mat m_train;
+	std::float_t m_ratio;
+
+	bool matchRow(const std::uint8_t *query, std::int32_t queryIdx, cv::DMatch &match) const;
+};
\ No newline at end of file
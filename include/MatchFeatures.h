@@ -9,9 +9,29 @@
 #include <iostream>
 #include <fstream>
 
+#include "HammingMatcher.h"
+#include "FrameCache.h"
+
 
 #define MIN_MATCH_COUNT 10
 
+// Lowe's ratio test threshold
+#define MATCH_RATIO_THRESH 0.4f
+// Rectification error (rows)
+#define MATCH_ROW_TOLERANCE 5
+
+// Epipolar matcher (rectified stereo): candidates within +-rows
+// and disparity range
+#define EPIPOLAR_ROW_TOLERANCE 2
+#define EPIPOLAR_MIN_DISPARITY 0
+#define EPIPOLAR_MAX_DISPARITY 256
+
+// Disparity model of the object: inlier if |dx - disparity| <= threshold
+#define DISPARITY_INLIER_THRESH 3.0f
+#define DISPARITY_MIN_INLIERS 3
+// Smaller disparity (far object or wrong model) gives no distance
+#define DISPARITY_MIN_DISTANCE 18
+
 enum class FeatureDetectorType
 {
 	DETECTOR_FAST,
@@ -38,28 +58,109 @@ enum class DescriptorExtractorType
 enum class MatcherType
 {
 	MATCHER_FLANNBASED,
-	MATCHER_BRUTEFORCE
+	MATCHER_BRUTEFORCE,
+	MATCHER_EPIPOLAR,	// Train keypoints bucketed by rows (rectified stereo only)
+	MATCHER_HAMMING		// SIMD popcount with fused ratio test (binary descriptors only)
+};
+
+
+//
+// Object in the right view of rectified stereo pair:
+// the left box shifted by one disparity (robust to wrong matches)
+struct DisparityModel
+{
+	bool isValid;
+	std::float_t disparity;
+	// Mean row offset of inliers (non-zero for unrectified frames)
+	std::float_t rowOffset;
+	// Box of the object in the right view
+	cv::Rect box;
+	// Inlier mask of point pairs
+	std::vector<std::uint8_t> inliers;
+	std::int32_t nInliers;
+
+	DisparityModel() :
+		isValid(false),
+		disparity(0),
+		rowOffset(0),
+		nInliers(0)
+	{}
 };
 
 
+//
+// Matching state of one thread.
+// MatchRegion may be called in parallel, each thread with its own context
+struct MatchContext
+{
+	// Copy of the frame matcher (BF / FLANN), trained once per frame
+	cv::Ptr<cv::DescriptorMatcher> matcher;
+	std::uint64_t frame;
+
+	MatchContext() :
+		frame(0)
+	{}
+};
+
+
+
 class MatchFeatures
 {
 public:
 	MatchFeatures(FeatureDetectorType detectorType = FeatureDetectorType::DETECTOR_ORB,
 		DescriptorExtractorType extractorType = DescriptorExtractorType::EXTRACTOR_ORB, MatcherType matcherType = MatcherType::MATCHER_BRUTEFORCE);
 	MatchFeatures(cv::Ptr<cv::Feature2D> detector, cv::Ptr<cv::Feature2D> extractor, cv::Ptr<cv::DescriptorMatcher> matcher) :
+		m_frame_id(0),
+		m_matcher_type(MatcherType::MATCHER_BRUTEFORCE),
+		m_norm_type(cv::NORM_HAMMING),
+		m_row_tolerance(EPIPOLAR_ROW_TOLERANCE),
+		m_min_disparity(EPIPOLAR_MIN_DISPARITY),
+		m_max_disparity(EPIPOLAR_MAX_DISPARITY),
+		m_hamming(MATCH_RATIO_THRESH),
 		m_detector(detector),
 		m_extractor(extractor),
 		m_matcher(matcher)
 	{}
 	~MatchFeatures();
 
+	// Matching with visualization (drawMatchesImage)
 	bool ComputeFeatures(const cv::Mat& query_image, const cv::Mat& train_image, cv::Mat& destination, cv::Mat mask = cv::Mat());
 	bool ComputeFeaturesForStereo(const cv::Mat& stereopair, cv::Mat& destination, cv::Mat mask = cv::Mat());
 
+	// Compute-only matching: point pairs into caller buffers (no drawing, no homography)
+	bool MatchPoints(const cv::Mat& query_image, const cv::Mat& train_image,
+		std::vector<cv::Point2f>& queryPts, std::vector<cv::Point2f>& trainPts, cv::Mat mask = cv::Mat());
+	void getDisparities(std::vector<std::float_t>& disparities) const;
+	// One-parameter model of matched points of the box (1-D consensus over dx).
+	// Much cheaper than homography RANSAC, the same answer for drawing and distance
+	static bool estimateDisparity(const std::vector<cv::Point2f>& queryPts, const std::vector<cv::Point2f>& trainPts, const cv::Rect& box,
+		DisparityModel& model, std::float_t threshold = DISPARITY_INLIER_THRESH);
+
+	// Debug visualization of the last matches (opt-in)
+	void drawMatchesImage(const cv::Mat& query_image, const cv::Mat& train_image, cv::Mat& destination, cv::Mat mask = cv::Mat());
+
+	// Per-frame stage: keypoints and descriptors of both views are computed once,
+	// train descriptors are added to the matcher (shared by all regions)
+	bool ComputeFrameFeatures(const cv::Mat& query_image, const cv::Mat& train_image);
+	// Features are detected on grayscale views of the caches (converted once per frame)
+	bool ComputeFrameFeatures(FrameCache& query, FrameCache& train);
+	// Match query keypoints inside the box with the train view.
+	// Result is also available by getMatchedPoints
+	std::vector<cv::DMatch> MatchRegion(const cv::Rect& box);
+	// Re-entrant version (frame features are only read)
+	std::vector<cv::DMatch> MatchRegion(const cv::Rect& box, MatchContext& context) const;
+
 	bool writeGoodPoints(std::string filename);
 	bool readGoodPoints(std::string filename, std::vector<cv::Point2f>& pointsQuery, std::vector<cv::Point2f>& pointsTrain);
 
+	// Epipolar matcher constraints
+	void setEpipolarParams(std::int32_t rowTolerance, std::float_t minDisparity, std::float_t maxDisparity)
+	{
+		m_row_tolerance = rowTolerance;
+		m_min_disparity = minDisparity;
+		m_max_disparity = maxDisparity;
+	}
+
 	std::vector<cv::KeyPoint>	getKeypoints1() { return m_keypoints_query; }
 	std::vector<cv::KeyPoint>	getKeypoints2() { return m_keypoints_train; }
 	std::vector<cv::DMatch>		getm_good_matches() { return m_good_matches; }
@@ -73,7 +174,11 @@ public:
 	// --TODO
 	void getMatchedPoints(std::vector<cv::Point2f> &queryPts, std::vector<cv::Point2f> &trainPts)
 	{
-		for (auto idx : m_good_matches)
+		getMatchedPoints(m_good_matches, queryPts, trainPts);
+	}
+	void getMatchedPoints(const std::vector<cv::DMatch> &matches, std::vector<cv::Point2f> &queryPts, std::vector<cv::Point2f> &trainPts) const
+	{
+		for (auto idx : matches)
 		{
 			queryPts.push_back(cv::Point2f(m_keypoints_query[idx.queryIdx].pt.x, m_keypoints_query[idx.queryIdx].pt.y));
 			trainPts.push_back(cv::Point2f(m_keypoints_train[idx.trainIdx].pt.x, m_keypoints_train[idx.trainIdx].pt.y));
@@ -86,20 +191,43 @@ private:
 	std::vector<cv::KeyPoint> m_keypoints_query, m_keypoints_train;
 	std::vector<cv::DMatch> m_good_matches;
 
+	// Descriptors of the frame (ComputeFrameFeatures)
+	cv::Mat m_descriptors_query, m_descriptors_train;
+	std::uint64_t m_frame_id;
+	// Context of the non re-entrant MatchRegion
+	MatchContext m_context;
+
 	FeatureDetectorType m_detector_type;
 	DescriptorExtractorType m_extractor_type;
+	MatcherType m_matcher_type;
+
+	// Epipolar matcher: norm of descriptors, constraints
+	// and indexes of train keypoints by rows
+	std::int32_t m_norm_type;
+	std::int32_t m_row_tolerance;
+	std::float_t m_min_disparity, m_max_disparity;
+	std::vector<std::vector<std::int32_t>> m_train_rows;
+
+	// Matcher of binary descriptors (MATCHER_HAMMING)
+	HammingMatcher m_hamming;
 
 	cv::Ptr<cv::Feature2D> m_detector;
 	cv::Ptr<cv::Feature2D> m_extractor;
 	cv::Ptr<cv::DescriptorMatcher> m_matcher;
 
+	bool computeMatches(const cv::Mat& query_image, const cv::Mat& train_image, const cv::Mat& mask);
+
 	void detectKeypoints(const cv::Mat &query_image, const cv::Mat& train_image, std::vector<cv::KeyPoint>& keypoints1, std::vector<cv::KeyPoint>& keypoints2, cv::Mat mask = cv::Mat());
 	void computeDescriptors(const cv::Mat &query_image, const cv::Mat& train_image,
 		std::vector<cv::KeyPoint>& keypoints1, cv::Mat& descriptors1, std::vector<cv::KeyPoint>& keypoints2, cv::Mat& descriptors2);
 
 	std::vector<cv::DMatch> matchDescriptors(cv::Mat& descriptors1, cv::Mat& descriptors2, std::float_t distanceCoeffMin = 3.5f, cv::Mat mask = cv::Mat());
 	std::vector<cv::DMatch> matchDescriptors(cv::Mat& descriptors1, cv::Mat& descriptors2, int k, cv::Mat mask = cv::Mat());
-	std::vector<cv::DMatch> ratioTest(const std::vector<std::vector<cv::DMatch>>& knn_matches, std::float_t ratio_thresh);
+	bool useHamming(const cv::Mat& descriptors) const { return m_matcher_type == MatcherType::MATCHER_HAMMING && descriptors.type() == CV_8UC1; }
+
+	void buildRowIndex(std::int32_t rows);
+	std::vector<cv::DMatch> matchEpipolar(const std::vector<std::int32_t>& queryIdxs, const cv::Mat& descriptors1, const cv::Mat& descriptors2) const;
+	std::vector<cv::DMatch> ratioTest(const std::vector<std::vector<cv::DMatch>>& knn_matches, std::float_t ratio_thresh) const;
 	std::vector<cv::DMatch> distanceFilter(const cv::Mat& descriptors, const std::vector<cv::DMatch>& matches, std::float_t distanceCoeffMin = 3.5f);
 
 	void localizeTheObject(const std::vector<cv::KeyPoint> keypoints1, const std::vector<cv::KeyPoint> keypoints2,
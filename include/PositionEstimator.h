@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+
+#include "core.hpp"
+
+#include "TrackingByMatching.h"
+
+
+// Smoothing of velocity
+#define POSITION_VELOCITY_ALPHA 0.3
+// Velocity is restarted if the previous position is older (seconds)
+#define POSITION_MAX_DT         1.0
+
+
+
+//
+// 3D position of tracked objects in the left (rectified) camera frame.
+// Box centres and disparities of the frame are reprojected through Q in one batch,
+// velocity and time to contact are estimated from consecutive positions
+class PositionEstimator
+{
+public:
+	PositionEstimator(const cv::Mat &Q, std::double_t velocityAlpha = POSITION_VELOCITY_ALPHA);
+	~PositionEstimator() {}
+
+	void setVelocityAlpha(std::double_t alpha)	{ m_velocity_alpha = alpha; }
+
+	// Objects with disparity of the frame are updated, time in seconds.
+	// Buffers are reused between frames
+	void update(std::vector<TrackedObject> &tObjects, std::double_t time);
+
+private:
+	cv::Matx44d m_Q;
+	std::double_t m_velocity_alpha;
+
+	// (x, y, disparity) -> (X, Y, Z)
+	std::vector<cv::Point3d> m_image, m_world;
+	std::vector<std::int32_t> m_indexes;
+};
\ No newline at end of file
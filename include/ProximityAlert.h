@@ -0,0 +1,151 @@
+#pragma once
+#include <map>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "TrackingByMatching.h"
+
+
+// Alert if time to contact is less (seconds)
+#define ALERT_TTC_THRESHOLD     2.0
+// Positions in a row required for a stable trend
+#define ALERT_MIN_POSITIONS     3
+// Alerts of one object are not repeated more often (seconds)
+#define ALERT_REPEAT_INTERVAL   1.0
+// Capacity of the queue (power of two)
+#define ALERT_QUEUE_SIZE        64
+// Worker wakes up at least so often (ms), in case of missed notification
+#define ALERT_WORKER_TIMEOUT    5
+
+
+
+//
+// Alert of an approaching object.
+// Ticks of cv::getTickCount: frame capture (glass), raising by the depth stage, delivery by the worker
+struct AlertEvent
+{
+	std::int32_t id_ext;
+	std::int32_t class_id;
+	std::double_t distance;
+	std::double_t ttc;
+
+	std::int64_t captureTick;
+	std::int64_t raiseTick;
+	std::int64_t deliverTick;
+};
+
+//
+// Latency of delivered alerts (ms)
+struct AlertLatency
+{
+	std::int64_t alerts;
+	std::int64_t dropped;
+
+	// Capture -> raise (pipeline up to the depth stage)
+	std::double_t meanRaise, maxRaise;
+	// Raise -> delivery (queue and worker)
+	std::double_t meanQueue, maxQueue;
+	// Capture -> delivery (glass to alert)
+	std::double_t meanTotal, maxTotal;
+
+	AlertLatency() :
+		alerts(0),
+		dropped(0),
+		meanRaise(0), maxRaise(0),
+		meanQueue(0), maxQueue(0),
+		meanTotal(0), maxTotal(0)
+	{}
+};
+
+//
+// Single producer / single consumer ring buffer without locks
+template<typename T, std::size_t N>
+class SpscQueue
+{
+	static_assert(N > 1 && (N & (N - 1)) == 0, "Size of the queue must be a power of two");
+
+public:
+	SpscQueue() :
+		m_head(0),
+		m_tail(0)
+	{}
+
+	// Producer. False if the queue is full
+	bool push(const T &value)
+	{
+		std::size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == N)	return false;
+
+		m_buffer[tail & (N - 1)] = value;
+		m_tail.store(tail + 1, std::memory_order_release);
+
+		return true;
+	}
+	// Consumer. False if the queue is empty
+	bool pop(T &value)
+	{
+		std::size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))	return false;
+
+		value = m_buffer[head & (N - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+private:
+	std::array<T, N> m_buffer;
+	// Indexes are on separate cache lines (written by different threads)
+	alignas(64) std::atomic<std::size_t> m_head;
+	alignas(64) std::atomic<std::size_t> m_tail;
+};
+
+
+
+//
+// Alert channel of approaching objects.
+// Checked right after the depth stage (before drawing), alerts are passed
+// through the lock-free queue to the worker thread which plays them
+class ProximityAlert
+{
+public:
+	typedef std::function<void(const AlertEvent&)> AlertSink;
+
+	ProximityAlert(AlertSink sink, std::double_t ttcThreshold = ALERT_TTC_THRESHOLD, std::double_t repeatInterval = ALERT_REPEAT_INTERVAL);
+	~ProximityAlert();
+
+	// Depth stage thread. Raises alerts of objects with small time to contact.
+	// Returns the number of raised alerts
+	std::int32_t check(const std::vector<TrackedObject> &tObjects, std::int64_t captureTick);
+
+	AlertLatency getLatency() const;
+
+private:
+	AlertSink m_sink;
+	std::double_t m_ttc_threshold;
+	std::double_t m_repeat_interval;
+
+	// Last alert of objects (by external id), producer only
+	std::map<std::int32_t, std::int64_t> m_last_alert;
+
+	SpscQueue<AlertEvent, ALERT_QUEUE_SIZE> m_queue;
+
+	// Wake up of the worker (the queue itself is not locked)
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::atomic<bool> m_isStopped;
+	std::thread m_thread;
+
+	// Latency (ticks), written by the worker
+	std::atomic<std::int64_t> m_alerts, m_dropped;
+	std::atomic<std::int64_t> m_sum_raise, m_max_raise;
+	std::atomic<std::int64_t> m_sum_queue, m_max_queue;
+	std::atomic<std::int64_t> m_sum_total, m_max_total;
+
+	void run();
+	void deliver(AlertEvent &event);
+};
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include <map>
+#include <vector>
+
+#include "core.hpp"
+#include "video.hpp"
+
+#include "TrackingByMatching.h"
+#include "FrameCache.h"
+
+
+// Re-detection of stereo points is required if fewer points survive
+#define STEREO_TRACK_MIN_POINTS     8
+// Change of row offset between left and right point (epipolar constraint)
+#define STEREO_TRACK_ROW_TOLERANCE  1.5
+// Points are re-detected periodically (drift)
+#define STEREO_TRACK_MAX_AGE        30
+
+#define STEREO_TRACK_WIN_SIZE       21
+#define STEREO_TRACK_MAX_LEVEL      3
+
+
+
+//
+// Matched stereo points of tracked objects moved by optical flow (KLT).
+// Left and right points are tracked independently on their views,
+// pairs breaking the epipolar constraint are dropped.
+// Feature matching is required only when few points survive
+class StereoPointTracker
+{
+public:
+	StereoPointTracker(std::int32_t minPoints = STEREO_TRACK_MIN_POINTS, std::int32_t maxAge = STEREO_TRACK_MAX_AGE,
+		std::float_t rowTolerance = STEREO_TRACK_ROW_TOLERANCE) :
+		m_min_points(minPoints),
+		m_max_age(maxAge),
+		m_row_tolerance(rowTolerance),
+		m_frame(0)
+	{}
+	~StereoPointTracker() {}
+
+	// Move points of objects to the new frame (pyramids are taken from caches of views).
+	// Points of objects not in the list are removed, all points are removed if the frame id
+	// of the cache does not follow the previous one
+	void update(FrameCache &left, FrameCache &right, const std::vector<TrackedObject> &tObjects);
+
+	// Tracked points of the object inside the box.
+	// False - points must be re-detected (setPoints)
+	bool getPoints(std::int32_t id, const cv::Rect &box, std::vector<cv::Point2f> &leftPts, std::vector<cv::Point2f> &rightPts) const;
+	// Matched points of the current frame
+	void setPoints(std::int32_t id, const std::vector<cv::Point2f> &leftPts, const std::vector<cv::Point2f> &rightPts);
+
+	void clear() { m_objects.clear(); }
+
+private:
+	//
+	// Point pairs of one object
+	struct StereoPoints
+	{
+		std::vector<cv::Point2f> left, right;
+		// Row offset of the pair at matching
+		std::vector<std::float_t> dy;
+
+		std::int32_t age;
+		std::uint64_t frame;
+	};
+
+	std::int32_t m_min_points;
+	std::int32_t m_max_age;
+	std::float_t m_row_tolerance;
+
+	// Points by internal id of the object
+	std::map<std::int32_t, StereoPoints> m_objects;
+
+	std::vector<cv::Mat> m_left, m_right;
+	std::vector<cv::Mat> m_prev_left, m_prev_right;
+	// Frame id of the last update
+	std::uint64_t m_frame;
+
+	void trackPoints(StereoPoints &points) const;
+};
\ No newline at end of file
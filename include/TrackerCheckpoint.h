@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "TrackingByMatching.h"
+
+
+#define CHECKPOINT_DEFAULT_PERIOD 30
+
+
+
+// Periodic checkpoints of the tracker state.
+// The state is serialized in the tracking thread (cheap),
+// writing to the file is done by the background thread
+class TrackerCheckpoint
+{
+public:
+	TrackerCheckpoint(std::string filename, std::int32_t period = CHECKPOINT_DEFAULT_PERIOD);
+	~TrackerCheckpoint();
+
+	// Called after each tracked frame.
+	// Every period-th frame the state is passed to the writer
+	void update(const TrackingByMatching &tracker);
+
+	// Write the state now (e.g. before the tracker is deleted)
+	void flush(const TrackingByMatching &tracker);
+
+private:
+	std::string m_filename;
+	std::int32_t m_period;
+	std::int32_t m_counter;
+
+	// Last state not yet written
+	std::vector<std::uint8_t> m_state;
+	bool m_isPending;
+	bool m_isStopped;
+
+	// Sequence numbers of states (older state never replaces newer one)
+	std::uint64_t m_sequence, m_written;
+
+	std::mutex m_mutex, m_file_mutex;
+	std::condition_variable m_cond;
+	std::thread m_thread;
+
+	void run();
+	bool write(const std::vector<std::uint8_t> &state, std::uint64_t sequence);
+};
@@ -1,5 +1,8 @@
 #pragma once
 #include <cmath>
+#include <atomic>
+#include <memory>
+#include <cstring>
 
 #include <core.hpp>
 #include <core/ocl.hpp>
@@ -7,11 +10,13 @@
 #include <video.hpp>
 
 #include "DnnDetector.h"
+#include "FrameCache.h"
 
 
 
-// --TODO
-// Coefficients (need to conduct tests to good worked)
+// Default coefficients.
+// At runtime TrackerParams are used (may be loaded from YAML,
+// tuned by TrackerTuning on recorded detections)
 
 #define TRACKER_MIN_AREAS_PERCENT	   0.7
 #define TRACKER_MIN_COVERAGE		   0.6
@@ -26,10 +31,160 @@
 #define TRACKER_WEIGHT_CONFIDENCE  0.05
 #define TRACKER_WEIGHT_CLASS_ID    0.4
 
+// Two-pass association by detection confidence.
+// Low-confidence detections only extend existing tracks
+#define TRACKER_HIGH_CONFIDENCE 0.5
+#define TRACKER_LOW_CONFIDENCE  0.1
+
+// Smoothing of distance (distAvg)
+#define TRACKER_DIST_ALPHA 0.1
+
 #define TRACKER_MIN_MISSED  7
 #define TRACKER_MAX_MISSED  100
 #define TRACKER_MIN_TRACKED 20
 
+// Box propagation by optical flow (between detector runs)
+#define TRACKER_FLOW_MAX_POINTS     40
+#define TRACKER_FLOW_MIN_POINTS     8
+#define TRACKER_FLOW_QUALITY        0.01
+#define TRACKER_FLOW_MIN_DISTANCE   5
+#define TRACKER_FLOW_WIN_SIZE       21
+#define TRACKER_FLOW_MAX_LEVEL      3
+#define TRACKER_FLOW_MAX_DEVIATION  4.0
+#define TRACKER_FLOW_MAX_FRAMES     15
+
+// Appearance (hue-saturation histogram of the box)
+// Used only for ambiguous matches and re-identification of lost objects
+#define TRACKER_APPEARANCE_H_BINS      16
+#define TRACKER_APPEARANCE_S_BINS      4
+#define TRACKER_APPEARANCE_ALPHA       0.1
+#define TRACKER_APPEARANCE_UPDATE_RATE 10
+#define TRACKER_WEIGHT_APPEARANCE      0.3
+#define TRACKER_MIN_APPEARANCE         0.7
+
+// Lost objects kept for re-identification
+#define TRACKER_LOST_MAX_MISSED 300
+#define TRACKER_LOST_MAX_SIZE   20
+
+
+
+//
+// Tracker parameters
+struct TrackerParams
+{
+	// Checks
+	std::double_t minAreasPercent;
+	std::double_t minCoverage;
+	std::double_t maxEucDistance;
+	std::double_t minConfidencePercent;
+
+	// Weights of checks and threshold of their sum
+	std::double_t checkWeight;
+	std::double_t weightArea;
+	std::double_t weightCoverage;
+	std::double_t weightEuc;
+	std::double_t weightConfidence;
+	std::double_t weightClassId;
+
+	// Confidence of detections (first / second pass)
+	std::double_t highConfidence;
+	std::double_t lowConfidence;
+	// Smoothing of distance
+	std::double_t distAlpha;
+
+	// Counters
+	std::int32_t minMissed;
+	std::int32_t maxMissed;
+	std::int32_t minTracked;
+
+	// Optical flow
+	std::int32_t  flowMaxPoints;
+	std::int32_t  flowMinPoints;
+	std::double_t flowQuality;
+	std::double_t flowMinDistance;
+	std::int32_t  flowWinSize;
+	std::int32_t  flowMaxLevel;
+	std::double_t flowMaxDeviation;
+	std::int32_t  flowMaxFrames;
+
+	// Appearance
+	std::double_t appearanceAlpha;
+	std::int32_t  appearanceUpdateRate;
+	std::double_t weightAppearance;
+	std::double_t minAppearance;
+
+	// Lost objects
+	std::int32_t lostMaxMissed;
+	std::int32_t lostMaxSize;
+
+	TrackerParams() :
+		minAreasPercent(TRACKER_MIN_AREAS_PERCENT),
+		minCoverage(TRACKER_MIN_COVERAGE),
+		maxEucDistance(TRACKER_MAX_EUC_DISTANCE),
+		minConfidencePercent(TRACKER_MIN_CONFIDENCE_PERCENT),
+		checkWeight(TRAKER_CHECK_WEIGHT),
+		weightArea(TRACKER_WEIGHT_AREA),
+		weightCoverage(TRACKER_WEIGHT_COVERAGE),
+		weightEuc(TRACKER_WEIGHT_EUC),
+		weightConfidence(TRACKER_WEIGHT_CONFIDENCE),
+		weightClassId(TRACKER_WEIGHT_CLASS_ID),
+		highConfidence(TRACKER_HIGH_CONFIDENCE),
+		lowConfidence(TRACKER_LOW_CONFIDENCE),
+		distAlpha(TRACKER_DIST_ALPHA),
+		minMissed(TRACKER_MIN_MISSED),
+		maxMissed(TRACKER_MAX_MISSED),
+		minTracked(TRACKER_MIN_TRACKED),
+		flowMaxPoints(TRACKER_FLOW_MAX_POINTS),
+		flowMinPoints(TRACKER_FLOW_MIN_POINTS),
+		flowQuality(TRACKER_FLOW_QUALITY),
+		flowMinDistance(TRACKER_FLOW_MIN_DISTANCE),
+		flowWinSize(TRACKER_FLOW_WIN_SIZE),
+		flowMaxLevel(TRACKER_FLOW_MAX_LEVEL),
+		flowMaxDeviation(TRACKER_FLOW_MAX_DEVIATION),
+		flowMaxFrames(TRACKER_FLOW_MAX_FRAMES),
+		appearanceAlpha(TRACKER_APPEARANCE_ALPHA),
+		appearanceUpdateRate(TRACKER_APPEARANCE_UPDATE_RATE),
+		weightAppearance(TRACKER_WEIGHT_APPEARANCE),
+		minAppearance(TRACKER_MIN_APPEARANCE),
+		lostMaxMissed(TRACKER_LOST_MAX_MISSED),
+		lostMaxSize(TRACKER_LOST_MAX_SIZE)
+	{}
+
+	// Missing values keep defaults
+	bool read(const std::string &filename);
+	void read(const cv::FileNode &node);
+	bool write(const std::string &filename) const;
+	void write(cv::FileStorage &fs) const;
+};
+
+
+
+//
+// Time of tracking stages (ticks of cv::getTickCount).
+// Collected only if profiling is enabled
+struct TrackerProfile
+{
+	std::int64_t frames;
+	// Sum of tracked objects over frames
+	std::int64_t objects;
+
+	std::int64_t track;
+	std::int64_t match;
+	std::int64_t repeat;
+	std::int64_t missed;
+	std::int64_t tracked;
+
+	TrackerProfile() :
+		frames(0),
+		objects(0),
+		track(0),
+		match(0),
+		repeat(0),
+		missed(0),
+		tracked(0)
+	{}
+};
+
 
 
 //
@@ -56,11 +211,33 @@ struct TrackedObject
 	// Calculation implemented in another module
 	std::double_t distance;
 	std::double_t distAvg;
+	// Frames since the distance was computed (-1 - never).
+	// Depth is not computed for all objects on every frame
+	std::int32_t distAge;
+	// Disparity of the box on the current frame (-1 if not computed).
+	// Not kept by the tracker
+	std::double_t disparity;
+	// Position in the left camera frame (units of baseline), velocity (per second),
+	// time of the position (seconds) and number of positions in a row.
+	// Time to contact in seconds (-1 if the object does not approach)
+	cv::Point3d position, velocity;
+	std::double_t positionTime;
+	std::int32_t positions;
+	std::double_t ttc;
 
 	// Counters
 	std::int32_t missed;
 	std::int32_t tracked;
 
+	// Points inside the box for propagation by optical flow
+	// and number of frames in a row the box was moved only by flow
+	std::vector<cv::Point2f> flowPts;
+	std::int32_t flowed;
+
+	// Appearance descriptor (normalized histogram).
+	// Smoothed by exponential moving average
+	cv::Mat appearance;
+
 	// --TODO Works
 	// Path from center points
 	std::vector<cv::Point2d> objPath;
@@ -75,9 +252,53 @@ struct TrackedObject
 		cm(-1, -1),
 		distance(-1),
 		distAvg(-1),
+		distAge(-1),
+		disparity(-1),
+		position(0, 0, 0),
+		velocity(0, 0, 0),
+		positionTime(-1),
+		positions(0),
+		ttc(-1),
 		missed(0),
-		tracked(0)
+		tracked(0),
+		flowed(0)
+	{}
+};
+
+
+
+//
+// Thread-safe allocator of object ids.
+// May be shared by several trackers (e.g. left and right views)
+// to get ids unique among all of them
+class TrackerIdAllocator
+{
+public:
+	TrackerIdAllocator() :
+		m_id_ext(0),
+		m_id_int(0)
 	{}
+	~TrackerIdAllocator() {}
+
+	std::int32_t createExtId() { return m_id_ext++; }
+	std::int32_t createIntId() { return m_id_int++; }
+
+	// Next ids to be created
+	std::int32_t getExtId() const { return m_id_ext; }
+	std::int32_t getIntId() const { return m_id_int; }
+
+	// Next ids will be not less than given (after restoring the state)
+	void reserveIds(std::int32_t idExt, std::int32_t idInt)
+	{
+		std::int32_t id = m_id_ext;
+		while (id < idExt && !m_id_ext.compare_exchange_weak(id, idExt));
+
+		id = m_id_int;
+		while (id < idInt && !m_id_int.compare_exchange_weak(id, idInt));
+	}
+
+private:
+	std::atomic<std::int32_t> m_id_ext, m_id_int;
 };
 
 
@@ -90,27 +311,102 @@ struct TrackedObject
 class TrackingByMatching
 {
 public:
-	TrackingByMatching() {}
+	// Without allocator ids are unique within the instance.
+	// Each instance may be used in its own thread
+	TrackingByMatching(std::shared_ptr<TrackerIdAllocator> idAllocator = nullptr) :
+		m_profiling(false),
+		m_id_ext(0),
+		m_id_int(0),
+		m_id_allocator(idAllocator)
+	{}
+	TrackingByMatching(const TrackerParams &params, std::shared_ptr<TrackerIdAllocator> idAllocator = nullptr) :
+		m_params(params),
+		m_profiling(false),
+		m_id_ext(0),
+		m_id_int(0),
+		m_id_allocator(idAllocator)
+	{}
 	~TrackingByMatching() {}
 
 	std::vector<TrackedObject> track(const std::vector<DetectedObject> &objects);
+	// Tracking with box propagation by optical flow.
+	// Frame may be passed without detected objects (detector did not run)
+	std::vector<TrackedObject> track(const std::vector<DetectedObject> &objects, const cv::Mat &frame);
+	// Grayscale and pyramid are taken from the frame cache (shared with other stages)
+	std::vector<TrackedObject> track(const std::vector<DetectedObject> &objects, FrameCache &frame);
 
 	std::vector<TrackedObject> getTrackedObjects() const { return m_tracked_objects; }
 
+	// Distances and positions are computed outside of the tracker (on copies of objects).
+	// Kept by internal id for the next frames
+	void updateDistances(const std::vector<TrackedObject> &objects);
+
+	void setParams(const TrackerParams &params) { m_params = params; }
+	const TrackerParams &getParams() const		{ return m_params; }
+
+	void setProfiling(bool enable)				{ m_profiling = enable; }
+	const TrackerProfile &getProfile() const	{ return m_profile; }
+	void resetProfile()							{ m_profile = TrackerProfile(); }
+
+	// Tracker state in compact binary format (for warm restart)
+	void serialize(std::vector<std::uint8_t> &buffer) const;
+	bool deserialize(const std::vector<std::uint8_t> &buffer);
+	bool save(const std::string &filename) const;
+	bool load(const std::string &filename);
+
 private:
+	TrackerParams m_params;
+
+	bool m_profiling;
+	TrackerProfile m_profile;
+
 	std::vector<TrackedObject> m_tracked_objects;
+	// Deleted objects with external id (for re-identification)
+	std::vector<TrackedObject> m_lost_objects;
+
+	// Current frame (valid only inside track)
+	cv::Mat m_frame;
+
+	// Grayscale pyramids of the current and previous frames
+	// (computed once per frame by the frame cache, shared by all tracks)
+	std::vector<cv::Mat> m_pyramid, m_prev_pyramid;
+	cv::Size m_frame_size;
+
+	// Next ids (if allocator is not set)
+	std::int32_t m_id_ext, m_id_int;
+	std::shared_ptr<TrackerIdAllocator> m_id_allocator;
 
 	void initializationObjects(const std::vector<DetectedObject> &detected_objects);
 	void addTrObject(const DetectedObject &dObj);
-	void updateTrObject(const DetectedObject &dObj, TrackedObject &tObj);
+	void updateTrObject(const DetectedObject &dObj, TrackedObject &tObj, cv::Mat appearance = cv::Mat());
 	void updateTrObject(const TrackedObject &tObj1, TrackedObject &tObj2);
+	std::int32_t findMatch(const DetectedObject &dObj, cv::Mat &appearance, bool onlyNotUpdated = false);
 
 	void checkTracked();
 	void checkMissed();
 	void checkRepeatObjects();
 	void eraseObject(std::int32_t id_int);
 
-	std::int32_t createUniqueExtId() const;
-	std::int32_t createUniqueIntId() const;
+	void buildPyramid(FrameCache &frame);
+	bool propagateObject(TrackedObject &tObj);
+	void seedFlowPoints(TrackedObject &tObj);
+
+	cv::Mat computeAppearance(const cv::Rect &box) const;
+	void updateAppearance(TrackedObject &tObj, const cv::Mat &appearance);
+	bool reidentifyObject(const DetectedObject &dObj, cv::Mat &appearance);
+	void checkLost();
+
+	// Adds time since stage start to counter
+	void profileStage(std::int64_t &counter, std::int64_t &stage)
+	{
+		if (!m_profiling)	return;
+
+		std::int64_t now = cv::getTickCount();
+		counter += now - stage;
+		stage = now;
+	}
+
+	std::int32_t createUniqueExtId();
+	std::int32_t createUniqueIntId();
 };
 
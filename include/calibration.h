@@ -2,6 +2,8 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <fstream>
+#include <memory>
 
 #include "calib3d.hpp"
 #include "highgui.hpp"
@@ -9,6 +11,15 @@
 #include "imgproc.hpp"
 
 
+// Rows per stripe for parallel remapping
+#define RECTIFY_STRIPE_ROWS 32
+// Grid step of the point rectification table (pixels)
+#define RECTIFY_LUT_STEP 8
+// Binary cache of calibration (next to the params file)
+#define CALIB_CACHE_EXT ".cache"
+#define CALIB_CACHE_VERSION 2
+
+
 namespace calib
 {
 	//! Calibration pattern
@@ -97,7 +108,8 @@ namespace calib
 			m_patternSize(patternSize),
 			m_squareSize(squareSize),
 			m_output(outputName),
-			m_rms(0.0)
+			m_rms(0.0),
+			m_isShow(true)
 		{}
 		~Calibration() {}
 
@@ -106,6 +118,9 @@ namespace calib
 		virtual void CalibrationByImagesVector(const std::vector<cv::Mat>& images) = 0;
 		virtual void writeParams() = 0;
 
+		/// Drawing of found corners when calibrating by images
+		void setShow(bool isShow) { m_isShow = isShow; }
+
 	protected:
 		std::float_t m_squareSize;		// The size of the side of the square / diameter circle
 		Pattern      m_pattern;			// Calibration pattern
@@ -116,8 +131,12 @@ namespace calib
 		// Roor mean square
 		std::double_t m_rms;
 
+		bool m_isShow;
+
 		virtual void createKnownPosition(std::vector<cv::Point3f>& corners);
 		virtual bool getCorners(const cv::Mat& imageArray, std::vector<cv::Point2f>& FoundCorners);
+		/// Corners of all images in parallel (results in the order of images)
+		void getCorners(const std::vector<cv::Mat>& images, std::vector<std::vector<cv::Point2f>>& corners, std::vector<std::uint8_t>& isFound);
 	};
 	class  SingleCalibration : public Calibration, public SingleCamera
 	{
@@ -159,6 +178,97 @@ namespace calib
 
 	
 
+	//
+	// Error of the point table against undistortPoints (pixels)
+	struct RectifyLutAccuracy
+	{
+		std::int32_t points;
+		std::double_t meanError;
+		std::double_t maxError;
+
+		RectifyLutAccuracy() :
+			points(0),
+			meanError(0),
+			maxError(0)
+		{}
+	};
+
+	//
+	// Undistortion and rectification of points by the table sampled on the image grid.
+	// Table is built once by undistortPoints, points are interpolated bilinearly
+	// (no iterative inversion of distortion per point)
+	class  RectifyPointLut
+	{
+	public:
+		RectifyPointLut() :
+			m_step(RECTIFY_LUT_STEP)
+		{}
+		~RectifyPointLut() {}
+
+		bool init(const cv::Mat &M, const cv::Mat &D, const cv::Mat &R, const cv::Mat &P, cv::Size imageSize,
+			std::int32_t step = RECTIFY_LUT_STEP);
+		bool isInitialized() const { return !m_lut.empty(); }
+
+		/// Batch of points (src and dst may be the same)
+		void map(const std::vector<cv::Point2f> &src, std::vector<cv::Point2f> &dst) const;
+		void map(const cv::Point2f *src, cv::Point2f *dst, std::size_t count) const;
+
+		/// Error on the grid of the image with the given step
+		RectifyLutAccuracy accuracy(std::int32_t step = 1) const;
+
+	private:
+		std::int32_t m_step;
+		cv::Size m_size;
+		// Rectified positions of grid nodes (CV_32FC2)
+		cv::Mat m_lut;
+
+		cv::Mat m_M, m_D, m_R, m_P;
+	};
+
+
+
+	//
+	// Binary file of matrices, read by memory mapping.
+	// Keyed by the hash of the source file: stale cache is not opened
+	class  CalibrationCache
+	{
+	public:
+		CalibrationCache() :
+			m_data(nullptr),
+			m_size(0),
+			m_handle(nullptr)
+		{}
+		~CalibrationCache() { close(); }
+
+		CalibrationCache(const CalibrationCache &) = delete;
+		CalibrationCache &operator=(const CalibrationCache &) = delete;
+
+		/// FNV-1a 64 of the file contents (0 if file not read)
+		static std::uint64_t hashFile(const std::string &filename);
+
+		/// Matrices are stored in the given order (empty matrices allowed)
+		static bool write(const std::string &filename, std::uint64_t hash, const std::vector<cv::Mat> &mats);
+
+		/// Mapping of the file, the header must match the hash and version.
+		/// Matrices refer to the mapped memory (copy-on-write) while the cache is opened
+		bool open(const std::string &filename, std::uint64_t hash);
+		void close();
+		bool isOpened() const { return m_data != nullptr; }
+
+		std::size_t size() const { return m_mats.size(); }
+		const cv::Mat &at(std::size_t i) const { return m_mats[i]; }
+
+	private:
+		void *m_data;
+		std::size_t m_size;
+		// File mapping object (Win32)
+		void *m_handle;
+
+		std::vector<cv::Mat> m_mats;
+	};
+
+
+
 	//
 	// Calibration Reading Class Set 
 	//
@@ -167,10 +277,11 @@ namespace calib
 	{
 	public:
 		CalibrationReader(std::string filename) :
-			m_fsParams(filename, cv::FileStorage::READ),
+			m_filename(filename),
 			m_isReceived(false)
 		{
-			CV_Assert(m_fsParams.isOpened());
+			// Parsing is deferred until read (params may come from the cache)
+			CV_Assert(std::ifstream(filename).good());
 		}
 		~CalibrationReader() {}
 
@@ -181,6 +292,7 @@ namespace calib
 		virtual bool isOpened() { return m_isReceived; }
 
 	protected:
+		std::string m_filename;
 		cv::FileStorage m_fsParams;
 
 		/// MATLAB, OpenCV
@@ -209,16 +321,24 @@ namespace calib
 
 		/// Reading intrinsic and extrinsic params
 		virtual bool read() final;
-		/// Compute all params
-		bool computeParams();
+		/// Compute all params (or load them from the binary cache).
+		/// Cache is rebuilt when the params file changes
+		bool computeParams(bool isCached = true);
 		/// Compute R1, R2, P1, P2, Q
 		bool computeRectifyParams();
-		/// Compute maps (for remapping)
-		bool computeUndistortMap();
+		/// Compute maps (for remapping).
+		/// CV_16SC2: map1 - fixed-point xy, map2 - interpolation table (faster remap)
+		bool computeUndistortMap(std::int32_t mapType = CV_32FC1);
+		/// Tables of point rectification (instead of undistortPoints)
+		bool computePointLut(std::int32_t step = RECTIFY_LUT_STEP);
 		/// Main distance params
 		bool computeBaseline();
 		bool computeFocalLenght();
 
+		/// Binary cache of all params and fixed-point maps
+		bool loadCache(const std::string &filename);
+		bool saveCache(const std::string &filename);
+
 		/// Show intrinsic and extrinsic params
 		virtual void show() final;
 
@@ -237,17 +357,57 @@ namespace calib
 		cv::Mat getP1() { return P1.clone(); }
 		cv::Mat getP2() { return P2.clone(); }
 
+		cv::Mat getQ() { return Q.clone(); }
+
 		cv::Mat getEssential()   { return E.clone(); }
 		cv::Mat getFundamental() { return F.clone(); }
 
-		cv::Mat getMap1x() { return map1[0].clone(); }
-		cv::Mat getMap1y() { return map1[1].clone(); }
-		cv::Mat getMap2x() { return map2[0].clone(); }
-		cv::Mat getMap2y() { return map2[1].clone(); }
+		/// Maps are not copied (may refer to the mapped cache, see getCache)
+		cv::Mat getMap1x() { return map1[0]; }
+		cv::Mat getMap1y() { return map1[1]; }
+		cv::Mat getMap2x() { return map2[0]; }
+		cv::Mat getMap2y() { return map2[1]; }
+		std::int32_t getMapType() const { return map1[0].empty() ? -1 : map1[0].type(); }
+
+		/// Mapped cache (nullptr if params are computed). Keeps the maps valid
+		std::shared_ptr<CalibrationCache> getCache() const { return m_cache; }
+
+		const RectifyPointLut &getPointLut1() const { return m_point_lut[0]; }
+		const RectifyPointLut &getPointLut2() const { return m_point_lut[1]; }
 
 	protected:
 		virtual bool readAsOpenCV() final;
 		virtual bool readAsMatlab() final;
+
+	private:
+		RectifyPointLut m_point_lut[2];
+		// Mapped cache (maps refer to it)
+		std::shared_ptr<CalibrationCache> m_cache;
+	};
+
+
+
+	//
+	// Rectification of the stereo pair by precomputed maps.
+	// Fixed-point maps, remapping by row stripes in parallel
+	class  StereoRectifier
+	{
+	public:
+		StereoRectifier() {}
+		~StereoRectifier() {}
+
+		bool init(StereoCalibrationReader &params);
+		bool isInitialized() const { return !m_map1[0].empty() && !m_map2[0].empty(); }
+
+		/// Stereo pair (left | right) -> rectified stereo pair
+		void rectify(const cv::Mat &stereopair, cv::Mat &rectified) const;
+		void rectify(const cv::Mat &left, const cv::Mat &right, cv::Mat &leftRect, cv::Mat &rightRect) const;
+
+	private:
+		// Camera 1, camera 2 (CV_16SC2 + CV_16UC1)
+		cv::Mat m_map1[2], m_map2[2];
+		// Maps may refer to the mapped cache of params
+		std::shared_ptr<CalibrationCache> m_cache;
 	};
 
 
@@ -0,0 +1,224 @@
+#include "calibration.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace calib;
+
+namespace
+{
+	const char CACHE_MAGIC[8] = { 'S', 'G', 'C', 'A', 'L', 'I', 'B', '\0' };
+	// Data of matrices is aligned (SIMD loads of maps)
+	const std::uint64_t CACHE_ALIGN = 64;
+
+	struct CacheHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t count;
+		std::uint64_t hash;
+		std::uint64_t size;
+	};
+	struct CacheEntry
+	{
+		std::int32_t rows;
+		std::int32_t cols;
+		std::int32_t type;
+		std::int32_t reserved;
+		std::uint64_t offset;
+	};
+
+	std::uint64_t alignUp(std::uint64_t value)
+	{
+		return (value + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+	}
+}
+
+//
+// FNV-1a 64 of the file contents
+std::uint64_t CalibrationCache::hashFile(const std::string &filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())	return 0;
+
+	std::uint64_t hash = 14695981039346656037ULL;
+	char buffer[4096];
+	while (file)
+	{
+		file.read(buffer, sizeof(buffer));
+		for (std::streamsize i = 0; i < file.gcount(); i++)
+		{
+			hash ^= std::uint8_t(buffer[i]);
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	return hash;
+}
+
+//
+// Header, table of entries, aligned data of matrices.
+// Written to the temporary file first, so readers never see a partial cache
+bool CalibrationCache::write(const std::string &filename, std::uint64_t hash, const std::vector<cv::Mat> &mats)
+{
+	CacheHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CALIB_CACHE_VERSION;
+	header.count = std::uint32_t(mats.size());
+	header.hash = hash;
+
+	std::vector<CacheEntry> entries(mats.size());
+	std::uint64_t offset = alignUp(sizeof(CacheHeader) + sizeof(CacheEntry) * entries.size());
+	for (std::size_t i = 0; i < mats.size(); i++)
+	{
+		entries[i].rows = mats[i].rows;
+		entries[i].cols = mats[i].cols;
+		entries[i].type = mats[i].type();
+		entries[i].reserved = 0;
+		entries[i].offset = offset;
+
+		offset = alignUp(offset + mats[i].total() * mats[i].elemSize());
+	}
+	header.size = offset;
+
+	std::string tmpname = filename + ".tmp";
+	std::ofstream file(tmpname, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Calibration cache: " << tmpname << " not created" << std::endl;
+		return false;
+	}
+
+	const char zeros[CACHE_ALIGN] = {};
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char *>(entries.data()), sizeof(CacheEntry) * entries.size());
+	for (std::size_t i = 0; i < mats.size(); i++)
+	{
+		file.write(zeros, std::streamsize(entries[i].offset - std::uint64_t(file.tellp())));
+
+		// Rows may be not continuous
+		std::size_t rowSize = mats[i].cols * mats[i].elemSize();
+		for (std::int32_t y = 0; y < mats[i].rows; y++)
+			file.write(reinterpret_cast<const char *>(mats[i].ptr(y)), rowSize);
+	}
+	file.write(zeros, std::streamsize(header.size - std::uint64_t(file.tellp())));
+	file.close();
+
+	if (!file)
+	{
+		std::remove(tmpname.c_str());
+		return false;
+	}
+
+	// Atomic replacement of the old cache
+#ifdef _WIN32
+	return MoveFileExA(tmpname.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(tmpname.c_str(), filename.c_str()) == 0;
+#endif
+}
+
+//
+// Mapping of the file (copy-on-write, so matrices may be modified by users)
+bool CalibrationCache::open(const std::string &filename, std::uint64_t hash)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)	return false;
+
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= LONGLONG(sizeof(CacheHeader)))
+		mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr)	return false;
+
+	m_data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (m_data == nullptr)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+	m_handle = mapping;
+	m_size = std::size_t(fileSize.QuadPart);
+#else
+	std::int32_t fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)	return false;
+
+	struct stat st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size >= off_t(sizeof(CacheHeader)))
+		data = mmap(nullptr, std::size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)	return false;
+
+	m_data = data;
+	m_size = std::size_t(st.st_size);
+#endif
+
+	// Header and table check
+	const std::uint8_t *base = static_cast<const std::uint8_t *>(m_data);
+	const CacheHeader *header = reinterpret_cast<const CacheHeader *>(base);
+	if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+		header->version != CALIB_CACHE_VERSION || header->hash != hash || header->size != m_size ||
+		sizeof(CacheHeader) + sizeof(CacheEntry) * std::uint64_t(header->count) > m_size)
+	{
+		close();
+		return false;
+	}
+
+	const CacheEntry *entries = reinterpret_cast<const CacheEntry *>(base + sizeof(CacheHeader));
+	m_mats.resize(header->count);
+	for (std::uint32_t i = 0; i < header->count; i++)
+	{
+		const CacheEntry &entry = entries[i];
+		if (entry.rows < 0 || entry.cols < 0)
+		{
+			close();
+			return false;
+		}
+		if (entry.rows == 0 || entry.cols == 0)
+			continue;
+
+		std::uint64_t bytes = std::uint64_t(entry.rows) * entry.cols * CV_ELEM_SIZE(entry.type);
+		if (entry.offset + bytes > m_size)
+		{
+			close();
+			return false;
+		}
+
+		m_mats[i] = cv::Mat(entry.rows, entry.cols, entry.type, static_cast<std::uint8_t *>(m_data) + entry.offset);
+	}
+
+	return true;
+}
+void CalibrationCache::close()
+{
+	m_mats.clear();
+	if (m_data == nullptr)	return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_handle);
+#else
+	munmap(m_data, m_size);
+#endif
+
+	m_data = nullptr;
+	m_handle = nullptr;
+	m_size = 0;
+}
\ No newline at end of file
@@ -2,6 +2,21 @@
 
 using namespace calib;
 
+namespace
+{
+	// Order of matrices in the cache file
+	enum CacheEntries
+	{
+		CACHE_SCALARS,		// width, height, baseline, focal lenght
+		CACHE_M1, CACHE_D1, CACHE_M2, CACHE_D2,
+		CACHE_ROTATE, CACHE_T, CACHE_E, CACHE_F,
+		CACHE_R1, CACHE_R2, CACHE_P1, CACHE_P2, CACHE_Q,
+		CACHE_MAP1X, CACHE_MAP1Y, CACHE_MAP2X, CACHE_MAP2Y,
+		CACHE_FRAMEWORK,	// chars of UsedFramework
+		CACHE_COUNT
+	};
+}
+
 //
 // Show intrinsic and extrinsic params
 void StereoCalibrationReader::show()
@@ -36,7 +51,7 @@ bool StereoCalibrationReader::read()
 {
 	std::cout << ">> Download stereo calibrate parameters" << std::endl;
 
-	if (!m_fsParams.isOpened())
+	if (!m_fsParams.isOpened() && !m_fsParams.open(m_filename, cv::FileStorage::READ))
 	{
 		std::cout << "Stereo Params not received" << std::endl;
 		return false;
@@ -161,14 +176,24 @@ bool StereoCalibrationReader::readAsOpenCV()
 }
 
 
-bool StereoCalibrationReader::computeParams()
+bool StereoCalibrationReader::computeParams(bool isCached)
 {
+	std::string cachename = m_filename + CALIB_CACHE_EXT;
+	if (isCached && loadCache(cachename))
+		return computePointLut();
+
 	std::cout << ">> Compute All params" << std::endl;
 
-	return computeRectifyParams() &&
-		   computeUndistortMap()  &&
-		   computeBaseline()      &&
-		   computeFocalLenght();
+	bool isComputed = computeRectifyParams()         &&
+		              computeUndistortMap(CV_16SC2) &&
+		              computePointLut()             &&
+		              computeBaseline()             &&
+		              computeFocalLenght();
+
+	if (isComputed && isCached && !saveCache(cachename))
+		std::cout << "Calibration cache not saved" << std::endl;
+
+	return isComputed;
 }
 //
 // Compute R1, R2, P1, P2, Q
@@ -191,7 +216,7 @@ bool StereoCalibrationReader::computeRectifyParams()
 
 //
 // Compute maps (for remapping)
-bool StereoCalibrationReader::computeUndistortMap()
+bool StereoCalibrationReader::computeUndistortMap(std::int32_t mapType)
 {
 	if (!m_isReceived && !read())
 	{
@@ -213,12 +238,30 @@ bool StereoCalibrationReader::computeUndistortMap()
 
 	std::cout << ">> Compute Undistort map" << std::endl;
 
-	initUndistortRectifyMap(camera_matrix1, distortion_coeffs1, R1, P1, imageSize, CV_32FC1, map1[0], map1[1]);
-	initUndistortRectifyMap(camera_matrix2, distortion_coeffs2, R2, P2, imageSize, CV_32FC1, map2[0], map2[1]);
+	initUndistortRectifyMap(camera_matrix1, distortion_coeffs1, R1, P1, imageSize, mapType, map1[0], map1[1]);
+	initUndistortRectifyMap(camera_matrix2, distortion_coeffs2, R2, P2, imageSize, mapType, map2[0], map2[1]);
 
 	return true;
 }
 
+//
+// Tables of point rectification
+bool StereoCalibrationReader::computePointLut(std::int32_t step)
+{
+	if (R1.empty() || R2.empty() ||
+		P1.empty() || P2.empty())
+	{
+		std::cout << "Point table: R1, R2, P1, P2 empty" << std::endl;
+		if (!computeRectifyParams())
+			return false;
+	}
+
+	std::cout << ">> Compute point tables" << std::endl;
+
+	return m_point_lut[0].init(camera_matrix1, distortion_coeffs1, R1, P1, imageSize, step) &&
+		   m_point_lut[1].init(camera_matrix2, distortion_coeffs2, R2, P2, imageSize, step);
+}
+
 //
 // Main distance params
 bool StereoCalibrationReader::computeBaseline()
@@ -263,4 +306,94 @@ bool StereoCalibrationReader::computeFocalLenght()
 	focallenght = Q.at<std::double_t>(2, 3);
 
 	return true;
+}
+
+//
+// Binary cache keyed by the hash of the params file.
+// Small matrices are copied, maps refer to the mapped file
+bool StereoCalibrationReader::loadCache(const std::string &filename)
+{
+	std::uint64_t hash = CalibrationCache::hashFile(m_filename);
+	if (hash == 0)	return false;
+
+	std::shared_ptr<CalibrationCache> cache = std::make_shared<CalibrationCache>();
+	if (!cache->open(filename, hash) || cache->size() != CACHE_COUNT)
+		return false;
+
+	const cv::Mat &scalars = cache->at(CACHE_SCALARS);
+	if (scalars.empty() || cache->at(CACHE_T).empty() || cache->at(CACHE_MAP1X).empty() || cache->at(CACHE_MAP2X).empty())
+		return false;
+
+	std::cout << ">> Load calibration cache " << filename << std::endl;
+
+	imageSize = cv::Size(std::int32_t(scalars.at<std::double_t>(0)), std::int32_t(scalars.at<std::double_t>(1)));
+	baseline = scalars.at<std::double_t>(2);
+	focallenght = scalars.at<std::double_t>(3);
+
+	camera_matrix1 = cache->at(CACHE_M1).clone();
+	distortion_coeffs1 = cache->at(CACHE_D1).clone();
+	camera_matrix2 = cache->at(CACHE_M2).clone();
+	distortion_coeffs2 = cache->at(CACHE_D2).clone();
+
+	const cv::Mat &t = cache->at(CACHE_T);
+	Rotate = cache->at(CACHE_ROTATE).clone();
+	T = cv::Vec3d(t.at<std::double_t>(0), t.at<std::double_t>(1), t.at<std::double_t>(2));
+	E = cache->at(CACHE_E).clone();
+	F = cache->at(CACHE_F).clone();
+
+	R1 = cache->at(CACHE_R1).clone();
+	R2 = cache->at(CACHE_R2).clone();
+	P1 = cache->at(CACHE_P1).clone();
+	P2 = cache->at(CACHE_P2).clone();
+	Q = cache->at(CACHE_Q).clone();
+
+	map1[0] = cache->at(CACHE_MAP1X);
+	map1[1] = cache->at(CACHE_MAP1Y);
+	map2[0] = cache->at(CACHE_MAP2X);
+	map2[1] = cache->at(CACHE_MAP2Y);
+
+	const cv::Mat &framework = cache->at(CACHE_FRAMEWORK);
+	UsedFramework = framework.empty() ? std::string() : std::string(framework.ptr<char>(), framework.total());
+
+	m_cache = cache;
+	m_isReceived = true;
+
+	return true;
+}
+bool StereoCalibrationReader::saveCache(const std::string &filename)
+{
+	std::uint64_t hash = CalibrationCache::hashFile(m_filename);
+	if (!m_isReceived || hash == 0)	return false;
+
+	std::cout << ">> Save calibration cache " << filename << std::endl;
+
+	cv::Mat scalars(1, 4, CV_64FC1);
+	scalars.at<std::double_t>(0) = imageSize.width;
+	scalars.at<std::double_t>(1) = imageSize.height;
+	scalars.at<std::double_t>(2) = baseline;
+	scalars.at<std::double_t>(3) = focallenght;
+
+	std::vector<cv::Mat> mats(CACHE_COUNT);
+	mats[CACHE_SCALARS] = scalars;
+	mats[CACHE_M1] = camera_matrix1;
+	mats[CACHE_D1] = distortion_coeffs1;
+	mats[CACHE_M2] = camera_matrix2;
+	mats[CACHE_D2] = distortion_coeffs2;
+	mats[CACHE_ROTATE] = Rotate;
+	mats[CACHE_T] = cv::Mat(T);
+	mats[CACHE_E] = E;
+	mats[CACHE_F] = F;
+	mats[CACHE_R1] = R1;
+	mats[CACHE_R2] = R2;
+	mats[CACHE_P1] = P1;
+	mats[CACHE_P2] = P2;
+	mats[CACHE_Q] = Q;
+	mats[CACHE_MAP1X] = map1[0];
+	mats[CACHE_MAP1Y] = map1[1];
+	mats[CACHE_MAP2X] = map2[0];
+	mats[CACHE_MAP2Y] = map2[1];
+	if (!UsedFramework.empty())
+		mats[CACHE_FRAMEWORK] = cv::Mat(1, std::int32_t(UsedFramework.size()), CV_8UC1, const_cast<char *>(UsedFramework.data()));
+
+	return CalibrationCache::write(filename, hash, mats);
 }
\ No newline at end of file
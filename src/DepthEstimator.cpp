@@ -0,0 +1,331 @@
+#include "DepthEstimator.h"
+#include "calibration.h"
+
+
+DepthEstimator::DepthEstimator(std::double_t baseline, std::double_t focalLenght, DepthMode mode) :
+	m_baseline(baseline),
+	m_focal_lenght(focalLenght),
+	m_mode(mode),
+	m_dist_alpha(DEPTH_DIST_ALPHA)
+{
+	m_bm = cv::StereoBM::create(DEPTH_NUM_DISPARITIES, DEPTH_BM_BLOCK_SIZE);
+
+	m_sgbm = cv::StereoSGBM::create(0, DEPTH_NUM_DISPARITIES, DEPTH_SGBM_BLOCK_SIZE);
+	m_sgbm->setP1(8 * DEPTH_SGBM_BLOCK_SIZE * DEPTH_SGBM_BLOCK_SIZE);
+	m_sgbm->setP2(32 * DEPTH_SGBM_BLOCK_SIZE * DEPTH_SGBM_BLOCK_SIZE);
+	m_sgbm->setUniquenessRatio(10);
+	m_sgbm->setMode(cv::StereoSGBM::MODE_SGBM_3WAY);
+}
+
+//
+// Distance of visible tracked objects by dense disparity
+void DepthEstimator::compute(const cv::Mat &frame, std::vector<TrackedObject> &tObjects, std::int32_t maxMissed)
+{
+	std::vector<std::int32_t> visible;
+	for (std::int32_t i = 0; i < std::int32_t(tObjects.size()); i++)
+	{
+		if (tObjects[i].id_ext != -1 && tObjects[i].missed <= maxMissed)
+			visible.push_back(i);
+	}
+
+	compute(frame, tObjects, visible);
+}
+void DepthEstimator::compute(const cv::Mat &frame, std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &indexes)
+{
+	if (m_mode == DepthMode::DEPTH_FEATURES)	return;
+
+	cv::Rect left(0, 0, frame.cols / 2, frame.rows);
+	cv::Rect right(frame.cols / 2, 0, frame.cols / 2, frame.rows);
+
+	if (m_mode == DepthMode::DEPTH_TEMPLATE)
+	{
+		computeTemplates(frame(left), frame(right), tObjects, indexes);
+		return;
+	}
+
+	std::vector<DepthBand> bands = createBands(tObjects, indexes, left.size());
+
+	for (auto &band : bands)
+	{
+		cv::Rect roi(band.colBegin, band.rowBegin, band.colEnd - band.colBegin, band.rowEnd - band.rowBegin);
+
+		// Only the band is converted to grayscale
+		cv::Mat leftBand = frame(left)(roi), rightBand = frame(right)(roi);
+		if (frame.channels() != 1)
+		{
+			cv::cvtColor(leftBand, leftBand, cv::COLOR_BGR2GRAY);
+			cv::cvtColor(rightBand, rightBand, cv::COLOR_BGR2GRAY);
+		}
+
+		computeBand(leftBand, rightBand, band, tObjects);
+	}
+}
+
+//
+// Disparity range of the object (bounded by the previous distance)
+void DepthEstimator::getDisparityRange(const TrackedObject &tObj, std::double_t &minDisparity, std::double_t &maxDisparity) const
+{
+	minDisparity = 0;
+	maxDisparity = DEPTH_NUM_DISPARITIES;
+
+	if (tObj.distAvg > 0)
+	{
+		std::double_t disparity = m_baseline * m_focal_lenght / tObj.distAvg;
+		minDisparity = std::max(disparity * (1.0 - DEPTH_DISPARITY_MARGIN), 0.0);
+		maxDisparity = std::min(disparity * (1.0 + DEPTH_DISPARITY_MARGIN), std::double_t(DEPTH_NUM_DISPARITIES));
+	}
+}
+
+//
+// Distance of objects by template matching (objects are independent)
+void DepthEstimator::computeTemplates(const cv::Mat &left, const cv::Mat &right, std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &indexes) const
+{
+	cv::parallel_for_(cv::Range(0, std::int32_t(indexes.size())), [&](const cv::Range &range)
+	{
+		for (std::int32_t i = range.start; i < range.end; i++)
+		{
+			TrackedObject &tObj = tObjects[indexes[i]];
+
+			cv::Rect box = tObj.box & cv::Rect(cv::Point(0, 0), left.size());
+			if (box.width < DEPTH_NCC_MIN_SIZE || box.height < DEPTH_NCC_MIN_SIZE)	continue;
+
+			std::double_t minDisparity, maxDisparity;
+			getDisparityRange(tObj, minDisparity, maxDisparity);
+
+			setDistance(tObj, matchTemplate(left, right, box, minDisparity, maxDisparity));
+		}
+	});
+}
+
+//
+// Disparity of the box by NCC along the same rows of the right view (-1 if not found).
+// Coarse search of the whole range on the reduced images, refinement at the full resolution
+std::double_t DepthEstimator::matchTemplate(const cv::Mat &left, const cv::Mat &right, const cv::Rect &box,
+	std::double_t minDisparity, std::double_t maxDisparity) const
+{
+	// Strip of the right view: the box shifted by the disparity range
+	std::int32_t colBegin = std::max(box.x - cvCeil(maxDisparity), 0);
+	std::int32_t colEnd = std::min(box.x + box.width - cvFloor(minDisparity), right.cols);
+	if (colEnd - colBegin < box.width)	return -1;
+
+	// Only the box and the strip are converted to grayscale
+	cv::Mat templ = left(box), strip = right(cv::Rect(colBegin, box.y, colEnd - colBegin, box.height));
+	if (left.channels() != 1)
+	{
+		cv::cvtColor(templ, templ, cv::COLOR_BGR2GRAY);
+		cv::cvtColor(strip, strip, cv::COLOR_BGR2GRAY);
+	}
+
+	// Coarse search
+	std::int32_t level = 0;
+	cv::Mat templCoarse = templ, stripCoarse = strip;
+	while (level < DEPTH_NCC_MAX_LEVEL && std::min(templCoarse.cols, templCoarse.rows) >= 2 * DEPTH_NCC_MIN_SIZE)
+	{
+		cv::pyrDown(templCoarse, templCoarse);
+		cv::pyrDown(stripCoarse, stripCoarse);
+		level++;
+	}
+
+	std::int32_t peak = 0;
+	if (searchRow(stripCoarse, templCoarse, peak) < DEPTH_NCC_MIN_SCORE)	return -1;
+
+	// Refinement around the coarse peak
+	std::int32_t begin = 0, end = strip.cols;
+	if (level > 0)
+	{
+		begin = std::max((peak << level) - DEPTH_NCC_REFINE, 0);
+		end = std::min((peak << level) + DEPTH_NCC_REFINE + templ.cols + 1, strip.cols);
+		if (end - begin < templ.cols)	return -1;
+	}
+
+	cv::Mat score;
+	cv::matchTemplate(strip.colRange(begin, end), templ, score, cv::TM_CCOEFF_NORMED);
+
+	cv::Point maxLoc;
+	std::double_t maxScore = 0;
+	cv::minMaxLoc(score, nullptr, &maxScore, nullptr, &maxLoc);
+	if (maxScore < DEPTH_NCC_MIN_SCORE)	return -1;
+
+	// Sub-pixel peak (parabola through the neighbours)
+	std::double_t offset = 0;
+	const std::float_t *row = score.ptr<std::float_t>(0);
+	if (maxLoc.x > 0 && maxLoc.x < score.cols - 1)
+	{
+		std::double_t denom = row[maxLoc.x - 1] - 2.0 * row[maxLoc.x] + row[maxLoc.x + 1];
+		if (denom < 0)
+			offset = 0.5 * (row[maxLoc.x - 1] - row[maxLoc.x + 1]) / denom;
+	}
+
+	return box.x - (colBegin + begin + maxLoc.x + offset);
+}
+
+//
+// Best NCC position of the template along the strip (template and strip have equal heights)
+std::double_t DepthEstimator::searchRow(const cv::Mat &strip, const cv::Mat &templ, std::int32_t &peak) const
+{
+	if (strip.cols < templ.cols || strip.rows != templ.rows)	return -1;
+
+	// Normalization by integral images (OpenCV), correlation is vectorized
+	cv::Mat score;
+	cv::matchTemplate(strip, templ, score, cv::TM_CCOEFF_NORMED);
+
+	cv::Point maxLoc;
+	std::double_t maxScore = 0;
+	cv::minMaxLoc(score, nullptr, &maxScore, nullptr, &maxLoc);
+	peak = maxLoc.x;
+
+	return maxScore;
+}
+
+//
+// Row bands of boxes. Disparity range of the box is bounded by the previous distance.
+// Boxes with overlapping rows are merged into one band
+std::vector<DepthEstimator::DepthBand> DepthEstimator::createBands(const std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &indexes, cv::Size size) const
+{
+	const std::int32_t blockSize = m_mode == DepthMode::DEPTH_SGBM ? DEPTH_SGBM_BLOCK_SIZE : DEPTH_BM_BLOCK_SIZE;
+
+	std::vector<DepthBand> boxes;
+	for (auto i : indexes)
+	{
+		const TrackedObject &tObj = tObjects[i];
+
+		cv::Rect box = tObj.box & cv::Rect(cv::Point(0, 0), size);
+		if (box.area() == 0)	continue;
+
+		DepthBand band;
+		getDisparityRange(tObj, band.minDisparity, band.maxDisparity);
+
+		// Window of the matcher around the box
+		band.rowBegin = std::max(box.y - blockSize / 2, 0);
+		band.rowEnd = std::min(box.y + box.height + blockSize / 2, size.height);
+		band.colBegin = box.x;
+		band.colEnd = std::min(box.x + box.width + blockSize / 2, size.width);
+		band.objects.push_back(i);
+
+		boxes.push_back(band);
+	}
+
+	std::sort(boxes.begin(), boxes.end(), [](const DepthBand &b1, const DepthBand &b2) { return b1.rowBegin < b2.rowBegin; });
+
+	std::vector<DepthBand> bands;
+	for (auto &box : boxes)
+	{
+		if (!bands.empty() && box.rowBegin < bands.back().rowEnd)
+		{
+			DepthBand &band = bands.back();
+			band.rowEnd = std::max(band.rowEnd, box.rowEnd);
+			band.colBegin = std::min(band.colBegin, box.colBegin);
+			band.colEnd = std::max(band.colEnd, box.colEnd);
+			band.minDisparity = std::min(band.minDisparity, box.minDisparity);
+			band.maxDisparity = std::max(band.maxDisparity, box.maxDisparity);
+			band.objects.push_back(box.objects[0]);
+		}
+		else
+			bands.push_back(box);
+	}
+
+	// Right view is searched to the left of the boxes. The matcher leaves the first
+	// minDisparity + numDisparities columns invalid, so the band is widened by the real range
+	for (auto &band : bands)
+	{
+		std::int32_t minDisparity = 0, numDisparities = 0;
+		getMatcherRange(band, minDisparity, numDisparities);
+
+		band.colBegin = std::max(band.colBegin - minDisparity - numDisparities - blockSize / 2, 0);
+	}
+
+	return bands;
+}
+
+//
+// Disparity of the band and median depth of its boxes
+void DepthEstimator::computeBand(const cv::Mat &left, const cv::Mat &right, const DepthBand &band, std::vector<TrackedObject> &tObjects)
+{
+	std::int32_t minDisparity = 0, numDisparities = 0;
+	getMatcherRange(band, minDisparity, numDisparities);
+
+	const std::int32_t blockSize = m_mode == DepthMode::DEPTH_SGBM ? DEPTH_SGBM_BLOCK_SIZE : DEPTH_BM_BLOCK_SIZE;
+	if (left.cols <= minDisparity + numDisparities || left.rows < blockSize)	return;
+
+	// Fixed-point disparity (x16)
+	cv::Mat disparity;
+	if (m_mode == DepthMode::DEPTH_SGBM)
+	{
+		m_sgbm->setMinDisparity(minDisparity);
+		m_sgbm->setNumDisparities(numDisparities);
+		m_sgbm->compute(left, right, disparity);
+	}
+	else
+	{
+		m_bm->setMinDisparity(minDisparity);
+		m_bm->setNumDisparities(numDisparities);
+		m_bm->compute(left, right, disparity);
+	}
+
+	for (auto idx : band.objects)
+	{
+		TrackedObject &tObj = tObjects[idx];
+
+		cv::Rect box = (tObj.box - cv::Point(band.colBegin, band.rowBegin)) & cv::Rect(cv::Point(0, 0), disparity.size());
+		if (box.area() == 0)	continue;
+
+		setDistance(tObj, getMedianDisparity(disparity(box), minDisparity));
+	}
+}
+
+//
+// Range of the matcher (number of disparities is divisible by 16)
+void DepthEstimator::getMatcherRange(const DepthBand &band, std::int32_t &minDisparity, std::int32_t &numDisparities) const
+{
+	minDisparity = cvFloor(band.minDisparity);
+	numDisparities = ((cvCeil(band.maxDisparity) - minDisparity + 15) / 16) * 16;
+	numDisparities = std::max(std::min(numDisparities, DEPTH_NUM_DISPARITIES), 16);
+}
+
+//
+// Median of valid disparities (-1 if not enough)
+std::double_t DepthEstimator::getMedianDisparity(const cv::Mat &disparity, std::int32_t minDisparity) const
+{
+	std::vector<std::int16_t> values;
+	values.reserve(disparity.total());
+
+	for (std::int32_t y = 0; y < disparity.rows; y++)
+	{
+		const std::int16_t *row = disparity.ptr<std::int16_t>(y);
+		for (std::int32_t x = 0; x < disparity.cols; x++)
+		{
+			// Invalid pixels are (minDisparity - 1) * 16
+			if (row[x] >= minDisparity * 16)
+				values.push_back(row[x]);
+		}
+	}
+
+	if (values.empty() || values.size() < DEPTH_MIN_VALID_RATIO * disparity.total())
+		return -1;
+
+	std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+
+	return values[values.size() / 2] / 16.0;
+}
+
+//
+// Disparity, distance and smoothed distance
+void DepthEstimator::setDistance(TrackedObject &tObj, std::double_t disparity) const
+{
+	if (disparity <= 0)
+	{
+		tObj.distance = -1;
+		tObj.disparity = -1;
+		tObj.ttc = -1;
+		return;
+	}
+
+	tObj.disparity = disparity;
+	tObj.distance = calib::calculateDistance(m_baseline, m_focal_lenght, disparity);
+	tObj.distAge = 0;
+
+	if (tObj.distAvg != -1)
+		tObj.distAvg = (1.0 - m_dist_alpha) * tObj.distAvg + m_dist_alpha * tObj.distance;
+	else
+		tObj.distAvg = tObj.distance;
+}
\ No newline at end of file
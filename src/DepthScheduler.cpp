@@ -0,0 +1,71 @@
+#include "DepthScheduler.h"
+
+#include <algorithm>
+
+
+//
+// Navigation target first, then objects by priority while the budget allows
+std::vector<std::int32_t> DepthScheduler::select(const std::vector<TrackedObject> &tObjects, const std::vector<std::int32_t> &visible, std::int32_t navTarget) const
+{
+	// Number of objects within the budget (all until the cost is measured)
+	std::size_t capacity = visible.size();
+	if (m_budget > 0 && m_cost > 0)
+		capacity = std::max(std::size_t(m_budget / m_cost), std::size_t(1));
+
+	if (capacity >= visible.size())	return visible;
+
+	// The nearest distance is the scale of proximity
+	std::double_t minDist = 0;
+	for (auto idx : visible)
+	{
+		std::double_t dist = tObjects[idx].distAvg;
+		if (dist > 0 && (minDist == 0 || dist < minDist))
+			minDist = dist;
+	}
+
+	std::vector<std::pair<std::double_t, std::int32_t>> queue;
+	std::vector<std::int32_t> selected;
+	for (auto idx : visible)
+	{
+		const TrackedObject &tObj = tObjects[idx];
+
+		if (navTarget != -1 && tObj.id_ext == navTarget)
+		{
+			selected.push_back(idx);
+			continue;
+		}
+
+		std::double_t age = tObj.distAge >= 0 ? tObj.distAge + 1 : DEPTH_SCHED_NEVER_AGE;
+		std::double_t proximity = (minDist > 0 && tObj.distAvg > 0) ? minDist / tObj.distAvg : 0;
+
+		queue.push_back(std::make_pair(age * (1.0 + proximity), idx));
+	}
+
+	std::stable_sort(queue.begin(), queue.end(),
+		[](const std::pair<std::double_t, std::int32_t> &p1, const std::pair<std::double_t, std::int32_t> &p2) { return p1.first > p2.first; });
+
+	for (auto &item : queue)
+	{
+		if (selected.size() >= capacity)	break;
+		selected.push_back(item.second);
+	}
+
+	// Order of objects is kept (results are written in order)
+	std::sort(selected.begin(), selected.end());
+
+	return selected;
+}
+
+//
+// Cost of one object (frame overhead is shared by the objects)
+void DepthScheduler::report(std::int32_t nObjects, std::int64_t ticks)
+{
+	if (nObjects <= 0)	return;
+
+	std::double_t cost = ticks * 1000.0 / cv::getTickFrequency() / nObjects;
+
+	if (m_cost > 0)
+		m_cost = (1.0 - DEPTH_SCHED_COST_ALPHA) * m_cost + DEPTH_SCHED_COST_ALPHA * cost;
+	else
+		m_cost = cost;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "DetectionLog.h"
+
+
+
+bool DetectionLog::open(std::string filename)
+{
+	close();
+
+	m_out.open(filename, std::ios::out | std::ios::trunc);
+
+	if (!m_out.is_open())
+	{
+		std::cout << "Detection log not opened: " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void DetectionLog::close()
+{
+	if (m_out.is_open())
+		m_out.close();
+}
+
+//
+// Write objects of the frame processed by the detector
+void DetectionLog::write(const std::vector<DetectedObject> &objects, std::int32_t frame)
+{
+	if (!m_out.is_open())	return;
+
+	m_out << "frame " << frame << " " << objects.size() << "\n";
+
+	for (auto &dObj : objects)
+	{
+		m_out << dObj.class_id << " " << dObj.confidence << " "
+			<< dObj.box.x << " " << dObj.box.y << " " << dObj.box.width << " " << dObj.box.height << " "
+			<< dObj.classname << "\n";
+	}
+}
+
+//
+// Read all frames of the log
+bool DetectionLog::read(std::string filename, std::vector<std::vector<DetectedObject>> &frames,
+	std::vector<std::int32_t> *indexes)
+{
+	std::ifstream in(filename, std::ios::in);
+	if (!in.is_open())
+	{
+		std::cout << "Detection log not opened: " << filename << std::endl;
+		return false;
+	}
+
+	frames.clear();
+	if (indexes)
+		indexes->clear();
+
+	std::string line;
+	while (std::getline(in, line))
+	{
+		std::istringstream header(line);
+		std::string tag;
+		std::int32_t index = 0;
+		std::uint32_t count = 0;
+
+		header >> tag >> index >> count;
+		if (tag != "frame" || index < 0)
+		{
+			std::cout << "Detection log: wrong frame header: " << line << std::endl;
+			return false;
+		}
+
+		frames.push_back(std::vector<DetectedObject>());
+		if (indexes)
+			indexes->push_back(index);
+
+		for (std::uint32_t i = 0; i < count && std::getline(in, line); i++)
+		{
+			std::istringstream obj(line);
+			std::int32_t classId = -1;
+			std::double_t confidence = 0.0;
+			cv::Rect box;
+			std::string classname;
+
+			obj >> classId >> confidence >> box.x >> box.y >> box.width >> box.height;
+			std::getline(obj >> std::ws, classname);
+
+			if (classname.empty())	classname = "None";
+
+			frames.back().push_back(DetectedObject(classId, classname, confidence, box));
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -99,13 +99,12 @@ void DnnDetector::addClassesToVector()
 // Convert from mobilenet_ssd2 v2 to DetectedObject
 std::vector<DetectedObject> DnnDetector::convertToDetectedObjectVec(const cv::Mat &prob, cv::Size srcSize) const
 {
-	std::float_t scale = 0.5;
 	std::vector<DetectedObject> detObjects;
 	
 	for (std::uint32_t i = 0; i < prob.rows; i++)
 	{
 		std::double_t confidence = static_cast<std::double_t>(prob.at<std::float_t>(i, 2));
-		if (confidence < scale) continue;
+		if (confidence < m_confidence) continue;
 
 		std::int32_t classId	 = static_cast<std::int32_t>(prob.at<std::float_t>(i, 1));
 
@@ -0,0 +1,54 @@
+#include "FrameCache.h"
+
+
+//
+// Grayscale frame
+const cv::Mat &FrameCache::getGray()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return gray();
+}
+const cv::Mat &FrameCache::gray()
+{
+	if (m_gray.empty() && !m_frame.empty())
+	{
+		if (m_frame.channels() == 3)
+			cv::cvtColor(m_frame, m_gray, cv::COLOR_BGR2GRAY);
+		else if (m_frame.channels() == 4)
+			cv::cvtColor(m_frame, m_gray, cv::COLOR_BGRA2GRAY);
+		else
+			m_gray = m_frame;
+	}
+
+	return m_gray;
+}
+
+//
+// Optical flow pyramid of the grayscale frame
+const std::vector<cv::Mat> &FrameCache::getPyramid(std::int32_t winSize, std::int32_t maxLevel)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<cv::Mat> &pyramid = m_pyramids[std::make_pair(winSize, maxLevel)];
+	if (pyramid.empty() && !gray().empty())
+	{
+		cv::buildOpticalFlowPyramid(gray(), pyramid, cv::Size(winSize, winSize), maxLevel,
+			true, cv::BORDER_REFLECT_101, cv::BORDER_CONSTANT, false);
+	}
+
+	return pyramid;
+}
+
+//
+// Blurred grayscale frame
+const cv::Mat &FrameCache::getBlurred(std::int32_t kernelSize)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	cv::Mat &blurred = m_blurred[kernelSize];
+	if (blurred.empty() && !gray().empty())
+		cv::GaussianBlur(gray(), blurred, cv::Size(kernelSize, kernelSize), 0);
+
+	return blurred;
+}
\ No newline at end of file
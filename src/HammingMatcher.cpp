@@ -0,0 +1,214 @@
+#include <cstring>
+#include <climits>
+
+#include "HammingMatcher.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HAMMING_AVX2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAMMING_NEON
+#endif
+
+
+//
+// Popcount of 64 bits (SWAR, without intrinsics)
+static inline std::int32_t popcount64(std::uint64_t x)
+{
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+	return std::int32_t((x * 0x0101010101010101ULL) >> 56);
+}
+
+static std::int32_t distanceScalar(const std::uint8_t *a, const std::uint8_t *b, std::int32_t length)
+{
+	std::int32_t dist = 0, i = 0;
+
+	for (; i + 8 <= length; i += 8)
+	{
+		std::uint64_t va, vb;
+		std::memcpy(&va, a + i, 8);
+		std::memcpy(&vb, b + i, 8);
+
+		dist += popcount64(va ^ vb);
+	}
+	for (; i < length; i++)
+		dist += popcount64(std::uint64_t(a[i] ^ b[i]));
+
+	return dist;
+}
+
+#if defined(HAMMING_AVX2)
+//
+// Popcount of bytes by nibble lookup, sum of bytes by SAD (4 x 64 bit)
+static inline __m256i popcount256(__m256i v)
+{
+	const __m256i lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i lowMask = _mm256_set1_epi8(0x0f);
+
+	__m256i lo = _mm256_and_si256(v, lowMask);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+	__m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+
+	return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+static inline std::int32_t horizontalSum(__m256i sum)
+{
+	__m128i s = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+
+	return _mm_cvtsi128_si32(s) + _mm_extract_epi32(s, 2);
+}
+static std::int32_t distanceSimd(const std::uint8_t *a, const std::uint8_t *b, std::int32_t length)
+{
+	__m256i sum = _mm256_setzero_si256();
+	std::int32_t i = 0;
+
+	for (; i + 32 <= length; i += 32)
+	{
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+
+		sum = _mm256_add_epi64(sum, popcount256(_mm256_xor_si256(va, vb)));
+	}
+
+	return horizontalSum(sum) + distanceScalar(a + i, b + i, length - i);
+}
+#elif defined(HAMMING_NEON)
+static std::int32_t distanceSimd(const std::uint8_t *a, const std::uint8_t *b, std::int32_t length)
+{
+	uint16x8_t sum = vdupq_n_u16(0);
+	std::int32_t i = 0;
+
+	for (; i + 16 <= length; i += 16)
+	{
+		uint8x16_t x = veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+		sum = vpadalq_u8(sum, vcntq_u8(x));
+	}
+
+	uint64x2_t sum64 = vpaddlq_u32(vpaddlq_u16(sum));
+	std::int32_t dist = std::int32_t(vgetq_lane_u64(sum64, 0) + vgetq_lane_u64(sum64, 1));
+
+	return dist + distanceScalar(a + i, b + i, length - i);
+}
+#else
+static std::int32_t distanceSimd(const std::uint8_t *a, const std::uint8_t *b, std::int32_t length)
+{
+	return distanceScalar(a, b, length);
+}
+#endif
+
+
+std::int32_t HammingMatcher::distance(const std::uint8_t *a, const std::uint8_t *b, std::int32_t length)
+{
+	return distanceSimd(a, b, length);
+}
+
+const char* HammingMatcher::getBackendName()
+{
+#if defined(HAMMING_AVX2)
+	return "AVX2";
+#elif defined(HAMMING_NEON)
+	return "NEON";
+#else
+	return "SCALAR";
+#endif
+}
+
+void HammingMatcher::train(const cv::Mat &descriptors)
+{
+	CV_Assert(descriptors.empty() || descriptors.type() == CV_8UC1);
+
+	// Rows must be contiguous for the scan
+	m_train = descriptors.isContinuous() ? descriptors : descriptors.clone();
+}
+
+void HammingMatcher::match(const cv::Mat &queryDescriptors, std::vector<cv::DMatch> &matches) const
+{
+	matches.clear();
+
+	if (m_train.rows < 2 || queryDescriptors.empty())	return;
+	CV_Assert(queryDescriptors.type() == CV_8UC1 && queryDescriptors.cols == m_train.cols);
+
+	cv::DMatch match;
+	for (std::int32_t i = 0; i < queryDescriptors.rows; i++)
+	{
+		if (matchRow(queryDescriptors.ptr<std::uint8_t>(i), i, match))
+			matches.push_back(match);
+	}
+}
+void HammingMatcher::match(const cv::Mat &queryDescriptors, const std::vector<std::int32_t> &queryIdxs, std::vector<cv::DMatch> &matches) const
+{
+	matches.clear();
+
+	if (m_train.rows < 2 || queryDescriptors.empty())	return;
+	CV_Assert(queryDescriptors.type() == CV_8UC1 && queryDescriptors.cols == m_train.cols);
+
+	cv::DMatch match;
+	for (auto i : queryIdxs)
+	{
+		if (matchRow(queryDescriptors.ptr<std::uint8_t>(i), i, match))
+			matches.push_back(match);
+	}
+}
+
+//
+// Scan of train descriptors with two best distances.
+// Ratio test is checked at the end (no knn lists)
+bool HammingMatcher::matchRow(const std::uint8_t *query, std::int32_t queryIdx, cv::DMatch &match) const
+{
+	const std::int32_t length = m_train.cols;
+	const std::uint8_t *train = m_train.ptr<std::uint8_t>(0);
+
+	std::int32_t best = INT_MAX, second = INT_MAX, bestIdx = -1;
+
+#if defined(HAMMING_AVX2)
+	// ORB (32 bytes): query stays in register
+	if (length == 32)
+	{
+		const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query));
+
+		for (std::int32_t j = 0; j < m_train.rows; j++, train += 32)
+		{
+			__m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(train));
+			std::int32_t dist = horizontalSum(popcount256(_mm256_xor_si256(q, t)));
+
+			if (dist < best)
+			{
+				second = best;
+				best = dist;
+				bestIdx = j;
+			}
+			else if (dist < second)
+				second = dist;
+		}
+	}
+	else
+#endif
+	{
+		for (std::int32_t j = 0; j < m_train.rows; j++, train += length)
+		{
+			std::int32_t dist = distanceSimd(query, train, length);
+
+			if (dist < best)
+			{
+				second = best;
+				best = dist;
+				bestIdx = j;
+			}
+			else if (dist < second)
+				second = dist;
+		}
+	}
+
+	if (bestIdx == -1 || !(best < m_ratio * second))
+		return false;
+
+	match = cv::DMatch(queryIdx, bestIdx, std::float_t(best));
+
+	return true;
+}
\ No newline at end of file
@@ -1,9 +1,14 @@
+#include <cfloat>
+#include <algorithm>
+
 #include "MatchFeatures.h"
 
 #define ORB_NFEATURES 1000
 
 
-MatchFeatures::MatchFeatures(FeatureDetectorType detectorType, DescriptorExtractorType extractorType, MatcherType matcherType)
+MatchFeatures::MatchFeatures(FeatureDetectorType detectorType, DescriptorExtractorType extractorType, MatcherType matcherType) :
+	m_frame_id(0),
+	m_hamming(MATCH_RATIO_THRESH)
 {
 	std::double_t hessianThreshold = 400.0;
 	int nOctaves = 4;
@@ -14,6 +19,11 @@ MatchFeatures::MatchFeatures(FeatureDetectorType detectorType, DescriptorExtract
 
 	m_detector_type = detectorType;
 	m_extractor_type = extractorType;
+	m_matcher_type = matcherType;
+
+	m_row_tolerance = EPIPOLAR_ROW_TOLERANCE;
+	m_min_disparity = EPIPOLAR_MIN_DISPARITY;
+	m_max_disparity = EPIPOLAR_MAX_DISPARITY;
 
 	// Detector
 	switch (m_detector_type)
@@ -126,7 +136,32 @@ MatchFeatures::MatchFeatures(FeatureDetectorType detectorType, DescriptorExtract
 		}
 		std::cout << ">> Matcher: BRUTEFORCE" << std::endl;
 		break;
+	case MatcherType::MATCHER_EPIPOLAR:
+		// Descriptors are compared directly (without matcher)
+		std::cout << ">> Matcher: EPIPOLAR" << std::endl;
+		break;
+	case MatcherType::MATCHER_HAMMING:
+		// Float descriptors are matched by brute force
+		std::cout << ">> Matcher: HAMMING (" << HammingMatcher::getBackendName() << ")" << std::endl;
+		break;
 	}
+
+	// Norm for direct comparison of descriptors (epipolar matcher)
+	switch (m_extractor_type)
+	{
+	case DescriptorExtractorType::EXTRACTOR_SIFT:
+		m_norm_type = cv::NORM_L1;
+		break;
+	case DescriptorExtractorType::EXTRACTOR_SURF:
+		m_norm_type = cv::NORM_L2;
+		break;
+	default:
+		m_norm_type = cv::NORM_HAMMING;
+		break;
+	}
+
+	if (!m_matcher)
+		m_matcher = cv::BFMatcher::create(m_norm_type, false);
 }
 
 MatchFeatures::~MatchFeatures()
@@ -139,26 +174,110 @@ MatchFeatures::~MatchFeatures()
 	m_keypoints_train.clear();
 
 	m_good_matches.clear();
+
+	m_descriptors_query.release();
+	m_descriptors_train.release();
 }
 
 
 
 bool MatchFeatures::ComputeFeatures(const cv::Mat &query_image, const cv::Mat& train_image, cv::Mat& destination, cv::Mat mask)
 {
-	detectKeypoints(query_image, train_image, m_keypoints_query, m_keypoints_train, mask);
+	computeMatches(query_image, train_image, mask);
 
-	cv::Mat descriptors1, descriptors2;
-	computeDescriptors(query_image, train_image, m_keypoints_query, descriptors1, m_keypoints_train, descriptors2);
+	// Visualization is a separate layer
+	drawMatchesImage(query_image, train_image, destination, mask);
 
-	// Match descriptors
-	std::float_t distanceCoeffMin = 5.5;
-	int k = 2;
+	return true;
+}
+
+//
+// Compute-only: matched points into caller buffers.
+// No drawing and no homography
+bool MatchFeatures::MatchPoints(const cv::Mat& query_image, const cv::Mat& train_image,
+	std::vector<cv::Point2f>& queryPts, std::vector<cv::Point2f>& trainPts, cv::Mat mask)
+{
+	queryPts.clear();
+	trainPts.clear();
+
+	if (!computeMatches(query_image, train_image, mask))	return false;
+
+	getMatchedPoints(m_good_matches, queryPts, trainPts);
+
+	return !queryPts.empty();
+}
+
+//
+// Disparities (query x - train x) of the last matches
+void MatchFeatures::getDisparities(std::vector<std::float_t>& disparities) const
+{
+	disparities.clear();
+
+	for (auto &match : m_good_matches)
+		disparities.push_back(m_keypoints_query[match.queryIdx].pt.x - m_keypoints_train[match.trainIdx].pt.x);
+}
+
+//
+// Disparity of the object as the center of the widest consensus window of dx
+// (exhaustive 1-D RANSAC on sorted dx, O(n log n))
+bool MatchFeatures::estimateDisparity(const std::vector<cv::Point2f>& queryPts, const std::vector<cv::Point2f>& trainPts, const cv::Rect& box,
+	DisparityModel& model, std::float_t threshold)
+{
+	CV_Assert(queryPts.size() == trainPts.size());
+
+	model = DisparityModel();
+	model.inliers.assign(queryPts.size(), 0);
+	if (std::int32_t(queryPts.size()) < DISPARITY_MIN_INLIERS)	return false;
+
+	std::vector<std::float_t> dx(queryPts.size());
+	for (std::size_t i = 0; i < queryPts.size(); i++)
+		dx[i] = queryPts[i].x - trainPts[i].x;
+
+	std::vector<std::float_t> sorted = dx;
+	std::sort(sorted.begin(), sorted.end());
+
+	// Window [begin, end) of width 2 * threshold with the most points
+	std::size_t bestBegin = 0, bestEnd = 0;
+	for (std::size_t begin = 0, end = 0; begin < sorted.size(); begin++)
+	{
+		while (end < sorted.size() && sorted[end] - sorted[begin] <= 2 * threshold)
+			end++;
+
+		if (end - begin > bestEnd - bestBegin)
+		{
+			bestBegin = begin;
+			bestEnd = end;
+		}
+	}
 
-	if (m_extractor_type == DescriptorExtractorType::EXTRACTOR_SURF)
-		distanceCoeffMin = 2.0f;
+	// Refined by the mean of inliers
+	const std::float_t center = 0.5f * (sorted[bestBegin] + sorted[bestEnd - 1]);
+	std::double_t sumDx = 0, sumDy = 0;
+	for (std::size_t i = 0; i < dx.size(); i++)
+	{
+		if (std::abs(dx[i] - center) > threshold)	continue;
+
+		model.inliers[i] = 1;
+		model.nInliers++;
+		sumDx += dx[i];
+		sumDy += trainPts[i].y - queryPts[i].y;
+	}
 
-	m_good_matches = matchDescriptors(descriptors1, descriptors2, k, cv::Mat());
+	if (model.nInliers < DISPARITY_MIN_INLIERS)	return false;
 
+	model.disparity = std::float_t(sumDx / model.nInliers);
+	model.rowOffset = std::float_t(sumDy / model.nInliers);
+	model.box = cv::Rect(cvRound(box.x - model.disparity), cvRound(box.y + model.rowOffset), box.width, box.height);
+	model.isValid = true;
+
+	return true;
+}
+
+//
+// Debug visualization of the last matches (opt-in).
+// Localization of the object (disparity model) is drawn if there are enough matches
+void MatchFeatures::drawMatchesImage(const cv::Mat& query_image, const cv::Mat& train_image, cv::Mat& destination, cv::Mat mask)
+{
 	// Draw top matches
 	//std::cout << "--> Draw top matches" << std::endl;
 	drawMatches(query_image, m_keypoints_query, train_image, m_keypoints_train, m_good_matches, destination, cv::Scalar::all(-1),
@@ -171,6 +290,43 @@ bool MatchFeatures::ComputeFeatures(const cv::Mat &query_image, const cv::Mat& t
 	{
 		localizeTheObject(m_keypoints_query, m_keypoints_train, m_good_matches, query_image, destination, mask);
 	}
+}
+
+//
+// Detect, describe and match the pair (result in m_good_matches)
+bool MatchFeatures::computeMatches(const cv::Mat& query_image, const cv::Mat& train_image, const cv::Mat& mask)
+{
+	m_good_matches.clear();
+
+	// Descriptors of the frame are replaced (contexts retrain their matchers)
+	m_frame_id++;
+
+	detectKeypoints(query_image, train_image, m_keypoints_query, m_keypoints_train, mask);
+	computeDescriptors(query_image, train_image, m_keypoints_query, m_descriptors_query, m_keypoints_train, m_descriptors_train);
+
+	if (m_descriptors_query.empty() || m_descriptors_train.empty())
+		return false;
+
+	// Match descriptors
+	int k = 2;
+
+	if (m_matcher_type == MatcherType::MATCHER_EPIPOLAR)
+	{
+		buildRowIndex(train_image.rows);
+
+		std::vector<std::int32_t> queryIdxs(m_keypoints_query.size());
+		for (std::int32_t i = 0; i < std::int32_t(queryIdxs.size()); i++)
+			queryIdxs[i] = i;
+
+		m_good_matches = matchEpipolar(queryIdxs, m_descriptors_query, m_descriptors_train);
+	}
+	else if (useHamming(m_descriptors_query))
+	{
+		m_hamming.train(m_descriptors_train);
+		m_hamming.match(m_descriptors_query, m_good_matches);
+	}
+	else
+		m_good_matches = matchDescriptors(m_descriptors_query, m_descriptors_train, k, cv::Mat());
 
 	return true;
 }
@@ -185,6 +341,119 @@ bool MatchFeatures::ComputeFeaturesForStereo(const cv::Mat& stereopair, cv::Mat&
 	return true;
 }
 
+//
+// Features of both views are computed once per frame.
+// Regions (tracked objects) are matched by MatchRegion
+bool MatchFeatures::ComputeFrameFeatures(const cv::Mat& query_image, const cv::Mat& train_image)
+{
+	m_good_matches.clear();
+	m_descriptors_query.release();
+	m_descriptors_train.release();
+	m_matcher->clear();
+	m_hamming.clear();
+
+	// Contexts retrain their matchers on the new frame
+	m_frame_id++;
+
+	detectKeypoints(query_image, train_image, m_keypoints_query, m_keypoints_train);
+	computeDescriptors(query_image, train_image, m_keypoints_query, m_descriptors_query, m_keypoints_train, m_descriptors_train);
+
+	// At least two train descriptors for the ratio test
+	if (m_descriptors_query.empty() || m_descriptors_train.rows < 2)
+		return false;
+
+	// Train index is built once and shared by all regions
+	// (BF / FLANN matchers are trained once per context in MatchRegion)
+	if (m_matcher_type == MatcherType::MATCHER_EPIPOLAR)
+		buildRowIndex(train_image.rows);
+	else if (useHamming(m_descriptors_train))
+		m_hamming.train(m_descriptors_train);
+
+	return true;
+}
+bool MatchFeatures::ComputeFrameFeatures(FrameCache& query, FrameCache& train)
+{
+	return ComputeFrameFeatures(query.getGray(), train.getGray());
+}
+
+//
+// Match query keypoints inside the box with the train view.
+// Matches outside the box rows (and with negative disparity) are rejected
+std::vector<cv::DMatch> MatchFeatures::MatchRegion(const cv::Rect& box)
+{
+	m_good_matches = MatchRegion(box, m_context);
+
+	return m_good_matches;
+}
+std::vector<cv::DMatch> MatchFeatures::MatchRegion(const cv::Rect& box, MatchContext& context) const
+{
+	std::vector<cv::DMatch> good_matches;
+
+	if (m_descriptors_query.empty() || m_descriptors_train.rows < 2)
+		return good_matches;
+
+	// Query keypoints inside the box
+	std::vector<std::int32_t> indexes;
+	for (std::int32_t i = 0; i < std::int32_t(m_keypoints_query.size()); i++)
+	{
+		if (box.contains(m_keypoints_query[i].pt))
+			indexes.push_back(i);
+	}
+	if (indexes.empty())
+		return good_matches;
+
+	// Epipolar matcher works with frame indexes directly
+	if (m_matcher_type == MatcherType::MATCHER_EPIPOLAR)
+		return matchEpipolar(indexes, m_descriptors_query, m_descriptors_train);
+
+	std::vector<cv::DMatch> matches;
+	if (useHamming(m_descriptors_query))
+	{
+		// Rows of the frame descriptors are used in place
+		m_hamming.match(m_descriptors_query, indexes, matches);
+	}
+	else
+	{
+		// Matcher of the context is trained once per frame
+		if (context.frame != m_frame_id || !context.matcher)
+		{
+			if (!context.matcher)
+				context.matcher = m_matcher->clone(true);
+
+			context.matcher->clear();
+			context.matcher->add(std::vector<cv::Mat>(1, m_descriptors_train));
+			context.matcher->train();
+			context.frame = m_frame_id;
+		}
+
+		cv::Mat descriptors(std::int32_t(indexes.size()), m_descriptors_query.cols, m_descriptors_query.type());
+		for (std::int32_t i = 0; i < std::int32_t(indexes.size()); i++)
+			m_descriptors_query.row(indexes[i]).copyTo(descriptors.row(i));
+
+		std::vector<std::vector<cv::DMatch>> knn_matches;
+		context.matcher->knnMatch(descriptors, knn_matches, 2);
+
+		matches = ratioTest(knn_matches, MATCH_RATIO_THRESH);
+
+		// Index in the frame keypoints
+		for (auto &match : matches)
+			match.queryIdx = indexes[match.queryIdx];
+	}
+
+	for (auto &match : matches)
+	{
+		const cv::Point2f &pt = m_keypoints_train[match.trainIdx].pt;
+
+		if (pt.y < box.y - MATCH_ROW_TOLERANCE || pt.y > box.y + box.height + MATCH_ROW_TOLERANCE ||
+			pt.x > box.x + box.width)
+			continue;
+
+		good_matches.push_back(match);
+	}
+
+	return good_matches;
+}
+
 // 
 // Detect the keypoints using Detector
 void MatchFeatures::detectKeypoints(const cv::Mat &query_image, const cv::Mat &train_image, std::vector<cv::KeyPoint>& keypoints1, std::vector<cv::KeyPoint>& keypoints2, cv::Mat mask)
@@ -207,11 +476,11 @@ void MatchFeatures::detectKeypoints(const cv::Mat &query_image, const cv::Mat &t
 void MatchFeatures::computeDescriptors(const cv::Mat &query_image, const cv::Mat& train_image,
 	std::vector<cv::KeyPoint>& keypoints1, cv::Mat& descriptors1, std::vector<cv::KeyPoint>& keypoints2, cv::Mat& descriptors2)
 {
-	if (keypoints1.empty() || keypoints2.empty())		return;
-	if (!descriptors1.empty() || !descriptors2.empty())
+	if (keypoints1.empty() || keypoints2.empty())
 	{
 		descriptors1.release();
 		descriptors2.release();
+		return;
 	}
 
 	//std::cout << "--> Compute the descriptors" << std::endl;
@@ -236,25 +505,95 @@ std::vector<cv::DMatch> MatchFeatures::matchDescriptors(cv::Mat& descriptors1, c
 // Find the k best matches for each descriptor from a query set
 std::vector<cv::DMatch> MatchFeatures::matchDescriptors(cv::Mat& descriptors1, cv::Mat& descriptors2, int k, cv::Mat mask)
 {
-	std::float_t ratioThresh = 0.4f;
 	std::vector<std::vector<cv::DMatch>> knn_matches;
 	m_matcher->knnMatch(descriptors1, descriptors2, knn_matches, k, mask, false);
 
 	// Filter matches using the Lowe's ratio test
-	std::vector<cv::DMatch> good_matches = ratioTest(knn_matches, ratioThresh);
+	std::vector<cv::DMatch> good_matches = ratioTest(knn_matches, MATCH_RATIO_THRESH);
+
+	return good_matches;
+}
+
+//
+// Indexes of train keypoints by rows (for epipolar matcher)
+void MatchFeatures::buildRowIndex(std::int32_t rows)
+{
+	m_train_rows.resize(rows);
+	for (auto &row : m_train_rows)
+		row.clear();
+
+	for (std::int32_t i = 0; i < std::int32_t(m_keypoints_train.size()); i++)
+	{
+		std::int32_t y = cvRound(m_keypoints_train[i].pt.y);
+		if (y >= 0 && y < rows)
+			m_train_rows[y].push_back(i);
+	}
+}
+
+//
+// Match query keypoints with train keypoints on the same rows (+-tolerance)
+// and in the disparity range. Two best candidates are checked by the ratio test.
+// Requires rectified stereo and buildRowIndex
+std::vector<cv::DMatch> MatchFeatures::matchEpipolar(const std::vector<std::int32_t>& queryIdxs, const cv::Mat& descriptors1, const cv::Mat& descriptors2) const
+{
+	std::vector<cv::DMatch> good_matches;
+
+	if (descriptors1.empty() || descriptors2.empty() || m_train_rows.empty())
+		return good_matches;
+
+	const std::int32_t rows = std::int32_t(m_train_rows.size());
+
+	// Binary descriptors are compared by popcount
+	const bool isBinary = m_norm_type == cv::NORM_HAMMING && descriptors1.type() == CV_8UC1 && descriptors2.type() == CV_8UC1;
+
+	for (auto queryIdx : queryIdxs)
+	{
+		const cv::Point2f &pt = m_keypoints_query[queryIdx].pt;
+		const cv::Mat descriptor = descriptors1.row(queryIdx);
+
+		std::int32_t y = cvRound(pt.y);
+		std::int32_t yBegin = std::max(y - m_row_tolerance, 0);
+		std::int32_t yEnd = std::min(y + m_row_tolerance, rows - 1);
+
+		cv::DMatch best(queryIdx, -1, FLT_MAX), second(queryIdx, -1, FLT_MAX);
+
+		for (std::int32_t row = yBegin; row <= yEnd; row++)
+		{
+			for (auto trainIdx : m_train_rows[row])
+			{
+				std::float_t disparity = pt.x - m_keypoints_train[trainIdx].pt.x;
+				if (disparity < m_min_disparity || disparity > m_max_disparity)	continue;
+
+				std::float_t distance = isBinary ?
+					std::float_t(HammingMatcher::distance(descriptors1.ptr<std::uint8_t>(queryIdx), descriptors2.ptr<std::uint8_t>(trainIdx), descriptors1.cols)) :
+					std::float_t(cv::norm(descriptor, descriptors2.row(trainIdx), m_norm_type));
+				if (distance < best.distance)
+				{
+					second = best;
+					best = cv::DMatch(queryIdx, trainIdx, distance);
+				}
+				else if (distance < second.distance)
+					second = cv::DMatch(queryIdx, trainIdx, distance);
+			}
+		}
+
+		// Single candidate passes (no ambiguity on the epipolar line)
+		if (best.trainIdx != -1 && (second.trainIdx == -1 || best.distance < MATCH_RATIO_THRESH * second.distance))
+			good_matches.push_back(best);
+	}
 
 	return good_matches;
 }
 
 // 
 // Filter knn_matches using the Lowe's ratio test
-std::vector<cv::DMatch> MatchFeatures::ratioTest(const std::vector<std::vector<cv::DMatch>>& knn_matches, const std::float_t ratioThresh)
+std::vector<cv::DMatch> MatchFeatures::ratioTest(const std::vector<std::vector<cv::DMatch>>& knn_matches, const std::float_t ratioThresh) const
 {
 	//std::cout << "--> Filter matches using the Lowe's ratio test" << std::endl;
 
 	std::vector<cv::DMatch> good_matches;
 	for (size_t i = 0; i < knn_matches.size(); i++)
-		if (knn_matches[i][0].distance < ratioThresh * knn_matches[i][1].distance)
+		if (knn_matches[i].size() > 1 && knn_matches[i][0].distance < ratioThresh * knn_matches[i][1].distance)
 			good_matches.push_back(knn_matches[i][0]);
 
 	return good_matches;
@@ -293,63 +632,36 @@ std::vector<cv::DMatch> MatchFeatures::distanceFilter(const cv::Mat& descriptors
 	return good_matches;
 }
 
-// --TODO Works not stable
-// Localize the object
+//
+// Localize the object in the train view.
+// Views are assumed rectified: the box is shifted by the disparity of the matches
 void MatchFeatures::localizeTheObject(const std::vector<cv::KeyPoint> keypoints1, const std::vector<cv::KeyPoint> keypoints2,
 	const std::vector<cv::DMatch>& good_matches, const cv::Mat& query_image, cv::Mat& destination, cv::Mat mask)
 {
-	//std::cout << "--> Localize the object" << std::endl;
-	try
-	{
-		// Draw roi rectangle on query_image
-		if (!mask.empty())
-		{
-			cv::Rect rec = boundingRect(mask);
-			rectangle(destination, rec, cv::Scalar(255), 5, 8, 0);
-		}
-
-		std::vector<cv::Point2f> queryPoints;
-		std::vector<cv::Point2f> trainPoints;
-
-		for (int i = 0; i < good_matches.size(); i++)
-		{
-			//-- Get the keypoints from the good matches
-			queryPoints.push_back(keypoints1[good_matches[i].queryIdx].pt);
-			trainPoints.push_back(keypoints2[good_matches[i].trainIdx].pt);
-		}
-
-		cv::Mat H = findHomography(queryPoints, trainPoints, cv::RANSAC);
+	cv::Rect rec(0, 0, query_image.cols, query_image.rows);
 
-		// Get the corners from the objImage ( the object to be "detected" )
-		std::vector<cv::Point2f> queryCorners(4);
-		if (!mask.empty())
-		{
-			cv::Rect rec = boundingRect(mask);
-			queryCorners[0] = cv::Point(rec.x, rec.y);
-			queryCorners[1] = cv::Point(rec.x + rec.width, rec.y);
-			queryCorners[2] = cv::Point(rec.x + rec.width, rec.y + rec.height);
-			queryCorners[3] = cv::Point(rec.x, rec.y + rec.height);
-		}
-		else
-		{
-			queryCorners[0] = cv::Point(0, 0);
-			queryCorners[1] = cv::Point(query_image.cols, 0);
-			queryCorners[2] = cv::Point(query_image.cols, query_image.rows);
-			queryCorners[3] = cv::Point(0, query_image.rows);
-		}
+	// Draw roi rectangle on query_image
+	if (!mask.empty())
+	{
+		rec = boundingRect(mask);
+		rectangle(destination, rec, cv::Scalar(255), 5, 8, 0);
+	}
 
-		std::vector<cv::Point2f> trainCorners(4);
-		perspectiveTransform(queryCorners, trainCorners, H);
+	std::vector<cv::Point2f> queryPoints;
+	std::vector<cv::Point2f> trainPoints;
 
-		// Draw lines between the corners (the mapped object in the scene - image_2 )
-		line(destination, trainCorners[0] + cv::Point2f(query_image.cols, 0), trainCorners[1] + cv::Point2f(query_image.cols, 0), cv::Scalar(255, 255, 255), 5);
-		line(destination, trainCorners[1] + cv::Point2f(query_image.cols, 0), trainCorners[2] + cv::Point2f(query_image.cols, 0), cv::Scalar(255, 255, 255), 5);
-		line(destination, trainCorners[2] + cv::Point2f(query_image.cols, 0), trainCorners[3] + cv::Point2f(query_image.cols, 0), cv::Scalar(255, 255, 255), 5);
-		line(destination, trainCorners[3] + cv::Point2f(query_image.cols, 0), trainCorners[0] + cv::Point2f(query_image.cols, 0), cv::Scalar(255, 255, 255), 5);
-	}
-	catch (cv::Exception)
+	for (int i = 0; i < good_matches.size(); i++)
 	{
+		//-- Get the keypoints from the good matches
+		queryPoints.push_back(keypoints1[good_matches[i].queryIdx].pt);
+		trainPoints.push_back(keypoints2[good_matches[i].trainIdx].pt);
 	}
+
+	DisparityModel model;
+	if (!estimateDisparity(queryPoints, trainPoints, rec, model))	return;
+
+	// Draw the mapped object in the scene - image_2
+	rectangle(destination, model.box + cv::Point(query_image.cols, 0), cv::Scalar(255, 255, 255), 5);
 }
 
 //
@@ -516,8 +828,8 @@ cv::Mat MatchFeatures::setMaskOnTrainImage(const cv::Size& trainImageSize, cv::M
 		rec.x = 0;
 
 		//  
-		rec.y -= 5;
-		rec.height += 10;
+		rec.y -= MATCH_ROW_TOLERANCE;
+		rec.height += 2 * MATCH_ROW_TOLERANCE;
 
 		cv::Mat roi = cv::Mat(maskTrain, rec);
 		roi = cv::Scalar(255);
@@ -0,0 +1,70 @@
+#include "PositionEstimator.h"
+
+
+PositionEstimator::PositionEstimator(const cv::Mat &Q, std::double_t velocityAlpha) :
+	m_Q(cv::Matx44d::eye()),
+	m_velocity_alpha(velocityAlpha)
+{
+	if (!Q.empty())
+	{
+		CV_Assert(Q.rows == 4 && Q.cols == 4);
+
+		cv::Mat q;
+		Q.convertTo(q, CV_64F);
+		m_Q = cv::Matx44d(q.ptr<std::double_t>());
+	}
+}
+
+//
+// Position, velocity and time to contact of objects
+void PositionEstimator::update(std::vector<TrackedObject> &tObjects, std::double_t time)
+{
+	m_image.clear();
+	m_indexes.clear();
+
+	for (std::int32_t i = 0; i < std::int32_t(tObjects.size()); i++)
+	{
+		const TrackedObject &tObj = tObjects[i];
+		if (tObj.disparity <= 0)	continue;
+
+		m_image.push_back(cv::Point3d(tObj.box.x + 0.5 * tObj.box.width, tObj.box.y + 0.5 * tObj.box.height, tObj.disparity));
+		m_indexes.push_back(i);
+	}
+	if (m_image.empty())	return;
+
+	// [X Y Z W]^T = Q * [x y d 1]^T
+	m_world.resize(m_image.size());
+	cv::perspectiveTransform(m_image, m_world, m_Q);
+
+	for (std::size_t i = 0; i < m_indexes.size(); i++)
+	{
+		TrackedObject &tObj = tObjects[m_indexes[i]];
+		const cv::Point3d &position = m_world[i];
+
+		std::double_t dt = time - tObj.positionTime;
+		if (tObj.positions > 0 && dt > 0 && dt <= POSITION_MAX_DT)
+		{
+			cv::Point3d velocity = (position - tObj.position) * (1.0 / dt);
+
+			if (tObj.positions > 1)
+				tObj.velocity = (1.0 - m_velocity_alpha) * tObj.velocity + m_velocity_alpha * velocity;
+			else
+				tObj.velocity = velocity;
+
+			tObj.positions++;
+		}
+		else
+		{
+			tObj.velocity = cv::Point3d(0, 0, 0);
+			tObj.positions = 1;
+		}
+
+		tObj.position = position;
+		tObj.positionTime = time;
+
+		// Time to contact by the range rate
+		std::double_t range = cv::norm(position);
+		std::double_t rangeRate = range > 0 ? position.dot(tObj.velocity) / range : 0;
+		tObj.ttc = rangeRate < 0 ? range / -rangeRate : -1;
+	}
+}
\ No newline at end of file
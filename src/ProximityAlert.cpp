@@ -0,0 +1,148 @@
+#include "ProximityAlert.h"
+
+#include <chrono>
+#include <algorithm>
+
+
+ProximityAlert::ProximityAlert(AlertSink sink, std::double_t ttcThreshold, std::double_t repeatInterval) :
+	m_sink(sink),
+	m_ttc_threshold(ttcThreshold),
+	m_repeat_interval(repeatInterval),
+	m_isStopped(false),
+	m_alerts(0),
+	m_dropped(0),
+	m_sum_raise(0), m_max_raise(0),
+	m_sum_queue(0), m_max_queue(0),
+	m_sum_total(0), m_max_total(0)
+{
+	m_thread = std::thread(&ProximityAlert::run, this);
+}
+
+ProximityAlert::~ProximityAlert()
+{
+	m_isStopped = true;
+	m_cond.notify_one();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+//
+// Raise alerts of approaching objects (never blocks)
+std::int32_t ProximityAlert::check(const std::vector<TrackedObject> &tObjects, std::int64_t captureTick)
+{
+	const std::int64_t now = cv::getTickCount();
+	const std::int64_t repeatTicks = std::int64_t(m_repeat_interval * cv::getTickFrequency());
+
+	std::int32_t raised = 0;
+	for (auto &tObj : tObjects)
+	{
+		// Time to contact must be measured on this frame (not kept from the previous depth)
+		if (tObj.id_ext == -1 || tObj.missed > 0 || tObj.distAge != 0)	continue;
+		if (tObj.ttc < 0 || tObj.ttc > m_ttc_threshold || tObj.positions < ALERT_MIN_POSITIONS)	continue;
+
+		auto it = m_last_alert.find(tObj.id_ext);
+		if (it != m_last_alert.end() && now - it->second < repeatTicks)	continue;
+
+		AlertEvent event;
+		event.id_ext = tObj.id_ext;
+		event.class_id = tObj.class_id;
+		event.distance = tObj.distance;
+		event.ttc = tObj.ttc;
+		event.captureTick = captureTick;
+		event.raiseTick = now;
+		event.deliverTick = 0;
+
+		if (!m_queue.push(event))
+		{
+			m_dropped++;
+			continue;
+		}
+
+		m_last_alert[tObj.id_ext] = now;
+		raised++;
+	}
+
+	// Objects which are not tracked anymore
+	for (auto it = m_last_alert.begin(); it != m_last_alert.end();)
+	{
+		std::int32_t id = it->first;
+		bool isTracked = std::any_of(tObjects.begin(), tObjects.end(), [id](const TrackedObject &tObj)
+		{
+			return tObj.id_ext == id;
+		});
+
+		it = isTracked ? std::next(it) : m_last_alert.erase(it);
+	}
+
+	if (raised)
+		m_cond.notify_one();
+
+	return raised;
+}
+
+//
+// Worker: delivers alerts to the sink
+void ProximityAlert::run()
+{
+	AlertEvent event;
+
+	while (true)
+	{
+		while (m_queue.pop(event))
+			deliver(event);
+
+		if (m_isStopped)	break;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait_for(lock, std::chrono::milliseconds(ALERT_WORKER_TIMEOUT));
+	}
+}
+
+void ProximityAlert::deliver(AlertEvent &event)
+{
+	event.deliverTick = cv::getTickCount();
+
+	auto updateMax = [](std::atomic<std::int64_t> &maxValue, std::int64_t value)
+	{
+		std::int64_t current = maxValue;
+		while (current < value && !maxValue.compare_exchange_weak(current, value));
+	};
+
+	const std::int64_t raise = event.raiseTick - event.captureTick;
+	const std::int64_t queue = event.deliverTick - event.raiseTick;
+	const std::int64_t total = event.deliverTick - event.captureTick;
+
+	m_sum_raise += raise;
+	m_sum_queue += queue;
+	m_sum_total += total;
+	updateMax(m_max_raise, raise);
+	updateMax(m_max_queue, queue);
+	updateMax(m_max_total, total);
+	m_alerts++;
+
+	if (m_sink)
+		m_sink(event);
+}
+
+//
+// Latency of delivered alerts (ms)
+AlertLatency ProximityAlert::getLatency() const
+{
+	AlertLatency latency;
+	latency.alerts = m_alerts;
+	latency.dropped = m_dropped;
+
+	const std::double_t msPerTick = 1000.0 / cv::getTickFrequency();
+	if (latency.alerts > 0)
+	{
+		latency.meanRaise = m_sum_raise * msPerTick / latency.alerts;
+		latency.meanQueue = m_sum_queue * msPerTick / latency.alerts;
+		latency.meanTotal = m_sum_total * msPerTick / latency.alerts;
+	}
+	latency.maxRaise = m_max_raise * msPerTick;
+	latency.maxQueue = m_max_queue * msPerTick;
+	latency.maxTotal = m_max_total * msPerTick;
+
+	return latency;
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "calibration.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+using namespace calib;
+
+//
+// Rectified positions of grid nodes (the last node covers the image border)
+bool RectifyPointLut::init(const cv::Mat &M, const cv::Mat &D, const cv::Mat &R, const cv::Mat &P, cv::Size imageSize, std::int32_t step)
+{
+	m_lut.release();
+	if (M.empty() || P.empty() || imageSize.area() == 0 || step <= 0)	return false;
+
+	m_step = step;
+	m_size = imageSize;
+	m_M = M.clone();
+	m_D = D.clone();
+	m_R = R.clone();
+	m_P = P.clone();
+
+	const std::int32_t cols = (imageSize.width + step - 1) / step + 1;
+	const std::int32_t rows = (imageSize.height + step - 1) / step + 1;
+
+	std::vector<cv::Point2f> nodes;
+	nodes.reserve(std::size_t(rows) * cols);
+	for (std::int32_t y = 0; y < rows; y++)
+		for (std::int32_t x = 0; x < cols; x++)
+			nodes.push_back(cv::Point2f(std::float_t(x * step), std::float_t(y * step)));
+
+	// One batch for all nodes
+	std::vector<cv::Point2f> rectified;
+	cv::undistortPoints(nodes, rectified, m_M, m_D, m_R, m_P);
+
+	m_lut.create(rows, cols, CV_32FC2);
+	std::copy(rectified.begin(), rectified.end(), m_lut.ptr<cv::Point2f>(0));
+
+	return true;
+}
+
+//
+// Bilinear interpolation of the nearest nodes
+void RectifyPointLut::map(const std::vector<cv::Point2f> &src, std::vector<cv::Point2f> &dst) const
+{
+	dst.resize(src.size());
+	map(src.data(), dst.data(), src.size());
+}
+void RectifyPointLut::map(const cv::Point2f *src, cv::Point2f *dst, std::size_t count) const
+{
+	CV_Assert(isInitialized() && m_lut.isContinuous());
+
+	const std::float_t scale = 1.0f / m_step;
+	const std::float_t maxX = std::float_t(m_lut.cols - 1) - 1e-3f;
+	const std::float_t maxY = std::float_t(m_lut.rows - 1) - 1e-3f;
+	// Table as interleaved x, y (row stride in floats)
+	const std::float_t *lut = m_lut.ptr<std::float_t>(0);
+	const std::int32_t stride = 2 * m_lut.cols;
+
+	std::size_t i = 0;
+
+#if CV_SIMD128
+	// 4 points per iteration: nodes of cells are gathered by offsets
+	const cv::v_float32x4 vScale = cv::v_setall_f32(scale), vZero = cv::v_setzero_f32();
+	const cv::v_float32x4 vMaxX = cv::v_setall_f32(maxX), vMaxY = cv::v_setall_f32(maxY);
+	const cv::v_float32x4 vCols = cv::v_setall_f32(std::float_t(m_lut.cols));
+	const cv::v_int32x4 vStride = cv::v_setall_s32(stride);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		cv::v_float32x4 x, y;
+		cv::v_load_deinterleave(reinterpret_cast<const std::float_t*>(src + i), x, y);
+
+		// Points outside of the image use the border cells
+		cv::v_float32x4 gx = cv::v_min(cv::v_max(x * vScale, vZero), vMaxX);
+		cv::v_float32x4 gy = cv::v_min(cv::v_max(y * vScale, vZero), vMaxY);
+
+		cv::v_float32x4 cx = cv::v_cvt_f32(cv::v_trunc(gx)), cy = cv::v_cvt_f32(cv::v_trunc(gy));
+		cv::v_float32x4 fx = gx - cx, fy = gy - cy;
+
+		// Offset of the top left node (node index is exact in float)
+		cv::v_int32x4 node = cv::v_round(cv::v_muladd(cy, vCols, cx));
+		cv::v_int32x4 top = node + node, bottom = top + vStride;
+
+		cv::v_float32x4 x00 = cv::v_lut(lut, top), y00 = cv::v_lut(lut + 1, top);
+		cv::v_float32x4 x01 = cv::v_lut(lut + 2, top), y01 = cv::v_lut(lut + 3, top);
+		cv::v_float32x4 x10 = cv::v_lut(lut, bottom), y10 = cv::v_lut(lut + 1, bottom);
+		cv::v_float32x4 x11 = cv::v_lut(lut + 2, bottom), y11 = cv::v_lut(lut + 3, bottom);
+
+		cv::v_float32x4 xt = cv::v_muladd(fx, x01 - x00, x00), xb = cv::v_muladd(fx, x11 - x10, x10);
+		cv::v_float32x4 yt = cv::v_muladd(fx, y01 - y00, y00), yb = cv::v_muladd(fx, y11 - y10, y10);
+
+		cv::v_store_interleave(reinterpret_cast<std::float_t*>(dst + i), cv::v_muladd(fy, xb - xt, xt), cv::v_muladd(fy, yb - yt, yt));
+	}
+#endif
+
+	// Tail (or all points without SIMD)
+	for (; i < count; i++)
+	{
+		std::float_t gx = std::min(std::max(src[i].x * scale, 0.0f), maxX);
+		std::float_t gy = std::min(std::max(src[i].y * scale, 0.0f), maxY);
+
+		std::int32_t cx = std::int32_t(gx), cy = std::int32_t(gy);
+		std::float_t fx = gx - cx, fy = gy - cy;
+
+		const std::float_t *p00 = lut + cy * stride + 2 * cx;
+		const std::float_t *p10 = p00 + stride;
+
+		std::float_t xt = p00[0] + fx * (p00[2] - p00[0]), xb = p10[0] + fx * (p10[2] - p10[0]);
+		std::float_t yt = p00[1] + fx * (p00[3] - p00[1]), yb = p10[1] + fx * (p10[3] - p10[1]);
+
+		dst[i] = cv::Point2f(xt + fy * (xb - xt), yt + fy * (yb - yt));
+	}
+}
+
+//
+// Error of the table against undistortPoints on the dense grid
+RectifyLutAccuracy RectifyPointLut::accuracy(std::int32_t step) const
+{
+	RectifyLutAccuracy result;
+	if (!isInitialized() || step <= 0)	return result;
+
+	std::vector<cv::Point2f> points;
+	for (std::int32_t y = 0; y < m_size.height; y += step)
+		for (std::int32_t x = 0; x < m_size.width; x += step)
+			points.push_back(cv::Point2f(std::float_t(x), std::float_t(y)));
+
+	std::vector<cv::Point2f> reference, interpolated;
+	cv::undistortPoints(points, reference, m_M, m_D, m_R, m_P);
+	map(points, interpolated);
+
+	for (std::size_t i = 0; i < points.size(); i++)
+	{
+		std::double_t error = cv::norm(reference[i] - interpolated[i]);
+
+		result.meanError += error;
+		result.maxError = std::max(result.maxError, error);
+	}
+
+	result.points = std::int32_t(points.size());
+	if (result.points > 0)
+		result.meanError /= result.points;
+
+	return result;
+}
\ No newline at end of file
@@ -78,34 +78,27 @@ void SingleCalibration::CalibrationByVideo(std::string videoPath)
 // Search corners in an array of images
 void SingleCalibration::CalibrationByImagesVector(const std::vector<cv::Mat>& images)
 {
-	std::vector<std::vector<cv::Point2f>> imagePoints;
+	if (images.empty())	return;
 
-	cv::Mat image = images[0];
-	imageSize = image.size();
+	imageSize = images[0].size();
 
 	std::string single_winname = "Single Calibration";
 	std::string corners_winname = "Corners";
-	\
+
 	std::cout << "Frame size: " << imageSize << std::endl;
 
+	// Corners of all images in parallel
+	std::vector<std::vector<cv::Point2f>> corners, imagePoints;
+	std::vector<std::uint8_t> isFound;
+	getCorners(images, corners, isFound);
+
 	std::uint32_t counter = 0;
-	for (int i = 0; i < images.size(); i++)
+	for (std::size_t i = 0; i < images.size(); i++)
 	{
-		image = images[i];
-
 		// Saving corner points if found
-		std::vector<cv::Point2f> corners;
-		bool isFound = getCorners(image, corners);
-		
-		if (isFound)
+		if (isFound[i])
 		{
-			imagePoints.push_back(corners);
-
-			cv::Mat drawCorn = image.clone();
-			cv::drawChessboardCorners(drawCorn, m_patternSize, corners, isFound);
-
-			cv::namedWindow(corners_winname, cv::WINDOW_FREERATIO);
-			cv::imshow(corners_winname, drawCorn);
+			imagePoints.push_back(corners[i]);
 
 			std::cout << ">>> Corners Save: " << counter << std::endl;
 			counter++;
@@ -115,7 +108,19 @@ void SingleCalibration::CalibrationByImagesVector(const std::vector<cv::Mat>& im
 			std::cout << "Corners not isFound" << std::endl;
 		}
 
-		// Text on image
+		if (!m_isShow)	continue;
+
+		if (isFound[i])
+		{
+			cv::Mat drawCorn = images[i].clone();
+			cv::drawChessboardCorners(drawCorn, m_patternSize, corners[i], true);
+
+			cv::namedWindow(corners_winname, cv::WINDOW_FREERATIO);
+			cv::imshow(corners_winname, drawCorn);
+		}
+
+		// Text on image (input images are not changed)
+		cv::Mat image = images[i].clone();
 		std::string putCount = "Corners isFound: " + std::to_string(counter);
 		cv::putText(image, putCount, cv::Size(image.cols * 0.01, image.rows * 0.8), 2, 2, cv::Scalar(255, 255, 255), 7, 8, false);
 
@@ -125,8 +130,11 @@ void SingleCalibration::CalibrationByImagesVector(const std::vector<cv::Mat>& im
 		cv::waitKey(100);
 	}
 
-	cv::destroyWindow(single_winname);
-	cv::destroyWindow(corners_winname);
+	if (m_isShow)
+	{
+		cv::destroyWindow(single_winname);
+		cv::destroyWindow(corners_winname);
+	}
 
 	// Calibration
 	std::cout << "Number of images: " << counter << std::endl;
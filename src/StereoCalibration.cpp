@@ -92,66 +92,71 @@ void StereoCalibration::CalibrationByVideo(std::string videoPath)
 // Search corners in an array of images
 void StereoCalibration::CalibrationByImagesVector(const std::vector<cv::Mat> &stereopairs)
 {
-	std::vector<std::vector<cv::Point2f>> imagePoints1, imagePoints2;
-
-	cv::Mat image = stereopairs[0];
+	if (stereopairs.empty())	return;
 
-	imageSize = cv::Size(image.cols / 2, image.rows);
+	imageSize = cv::Size(stereopairs[0].cols / 2, stereopairs[0].rows);
 
 	std::cout << "Frame size: " << imageSize << std::endl;
 
-	std::int8_t key = NULL;
-	std::uint32_t counter = 0;
-
-	for (auto stereoImg : stereopairs)
+	// Left and right views of all stereo pairs: 2 * i - left, 2 * i + 1 - right
+	std::vector<cv::Mat> views;
+	views.reserve(2 * stereopairs.size());
+	for (const cv::Mat &stereoImg : stereopairs)
 	{
-		cv::Mat left = cv::Mat(image, cv::Rect(0, 0, image.cols / 2, image.rows));
-		cv::Mat right = cv::Mat(image, cv::Rect(image.cols / 2, 0, image.cols / 2, image.rows));
+		views.push_back(cv::Mat(stereoImg, cv::Rect(0, 0, stereoImg.cols / 2, stereoImg.rows)));
+		views.push_back(cv::Mat(stereoImg, cv::Rect(stereoImg.cols / 2, 0, stereoImg.cols / 2, stereoImg.rows)));
+	}
 
-		std::vector<cv::Point2f> corners1, corners2;
+	// Corners of all views in parallel
+	std::vector<std::vector<cv::Point2f>> corners, imagePoints1, imagePoints2;
+	std::vector<std::uint8_t> isFound;
+	getCorners(views, corners, isFound);
 
-		bool found1 = getCorners(left, corners1);
-		bool found2 = getCorners(right, corners2);
+	std::uint32_t counter = 0;
+	for (std::size_t i = 0; i < stereopairs.size(); i++)
+	{
+		const std::vector<cv::Point2f> &corners1 = corners[2 * i], &corners2 = corners[2 * i + 1];
 
-		// Saving corner points if found
-		if (found1 && found2)
+		// Saving corner points if found in both views
+		if (!isFound[2 * i] || !isFound[2 * i + 1])
 		{
-			imagePoints1.push_back(corners1);
-			imagePoints2.push_back(corners2);
+			std::cout << "Corners not isFound" << std::endl;
+			continue;
+		}
 
-			std::cout << "--> Corners Save: " << counter << std::endl;
+		imagePoints1.push_back(corners1);
+		imagePoints2.push_back(corners2);
 
-			// Drawing
-			cv::Mat drawStereoCorn = stereoImg.clone();
+		std::cout << "--> Corners Save: " << counter << std::endl;
+		counter++;
 
-			// TODO -- using merge or convertTo
-			cvtColor(drawStereoCorn, drawStereoCorn, cv::COLOR_GRAY2BGR);
+		if (!m_isShow)	continue;
 
-			cv::Mat tmp = cv::Mat::zeros(cv::Size(image.rows, image.cols), CV_8UC1);
-			cv::Mat tmp1 = cv::Mat::zeros(cv::Size(image.rows, image.cols), CV_8UC1);
+		// Drawing
+		cv::Mat drawStereoCorn;
+		if (stereopairs[i].channels() == 1)
+			cvtColor(stereopairs[i], drawStereoCorn, cv::COLOR_GRAY2BGR);
+		else
+			drawStereoCorn = stereopairs[i].clone();
 
-			cv::Mat drawCorn1 = cv::Mat(drawStereoCorn, cv::Rect(0, 0, drawStereoCorn.cols / 2, drawStereoCorn.rows));
-			cv::Mat drawCorn2 = cv::Mat(drawStereoCorn, cv::Rect(drawStereoCorn.cols / 2, 0, drawStereoCorn.cols / 2, drawStereoCorn.rows));
+		cv::Mat drawCorn1 = cv::Mat(drawStereoCorn, cv::Rect(0, 0, drawStereoCorn.cols / 2, drawStereoCorn.rows));
+		cv::Mat drawCorn2 = cv::Mat(drawStereoCorn, cv::Rect(drawStereoCorn.cols / 2, 0, drawStereoCorn.cols / 2, drawStereoCorn.rows));
 
-			cv::drawChessboardCorners(drawCorn1, m_patternSize, corners1, found1);
-			cv::drawChessboardCorners(drawCorn2, m_patternSize, corners2, found2);
+		cv::drawChessboardCorners(drawCorn1, m_patternSize, corners1, true);
+		cv::drawChessboardCorners(drawCorn2, m_patternSize, corners2, true);
 
-			// Text on image
-			std::string putCount = "Corners isFound: " + std::to_string(counter);
-			cv::putText(drawStereoCorn, putCount, cv::Size(drawStereoCorn.cols * 0.01, drawStereoCorn.rows * 0.8), 2, 2, cv::Scalar(255, 255, 255), 7, 8, false);
+		// Text on image
+		std::string putCount = "Corners isFound: " + std::to_string(counter);
+		cv::putText(drawStereoCorn, putCount, cv::Size(drawStereoCorn.cols * 0.01, drawStereoCorn.rows * 0.8), 2, 2, cv::Scalar(255, 255, 255), 7, 8, false);
 
-			cv::namedWindow("CornersImage", cv::WINDOW_FREERATIO);
-			cv::imshow("CornersImage", drawStereoCorn);
-		}
-		else
-		{
-			std::cout << "Corners not isFound" << std::endl;
-		}
+		cv::namedWindow("CornersImage", cv::WINDOW_FREERATIO);
+		cv::imshow("CornersImage", drawStereoCorn);
 
-		char key = cv::waitKey(1);
+		cv::waitKey(1);
 	}
 
-	cv::destroyWindow("CornersImage");
+	if (m_isShow)
+		cv::destroyWindow("CornersImage");
 
 
 	// Calibration
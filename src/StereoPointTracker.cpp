@@ -0,0 +1,132 @@
+#include "StereoPointTracker.h"
+
+
+//
+// Move points of objects to the new frame
+void StereoPointTracker::update(FrameCache &left, FrameCache &right, const std::vector<TrackedObject> &tObjects)
+{
+	std::swap(m_prev_left, m_left);
+	std::swap(m_prev_right, m_right);
+
+	// The left pyramid is shared with the tracker (same window and levels)
+	m_left = left.getPyramid(STEREO_TRACK_WIN_SIZE, STEREO_TRACK_MAX_LEVEL);
+	m_right = right.getPyramid(STEREO_TRACK_WIN_SIZE, STEREO_TRACK_MAX_LEVEL);
+
+	// Points move between consecutive frames only (the frame id of the cache),
+	// a skipped frame breaks the tracks
+	bool isConsecutive = left.getId() == m_frame + 1;
+	m_frame = left.getId();
+
+	bool isValid = isConsecutive && !m_left.empty() && !m_right.empty() && !m_prev_left.empty() && m_prev_left[0].size() == m_left[0].size() &&
+		!m_prev_right.empty() && m_prev_right[0].size() == m_right[0].size();
+
+	// Objects of the previous frame still tracked
+	std::vector<StereoPoints*> objects;
+	for (auto it = m_objects.begin(); it != m_objects.end();)
+	{
+		bool isFound = false;
+		for (auto &tObj : tObjects)
+		{
+			if (tObj.id_int == it->first)
+			{
+				isFound = true;
+				break;
+			}
+		}
+
+		if (!isFound || !isValid || it->second.frame + 1 != m_frame)
+		{
+			it = m_objects.erase(it);
+			continue;
+		}
+
+		objects.push_back(&it->second);
+		++it;
+	}
+
+	// Objects are independent
+	cv::parallel_for_(cv::Range(0, std::int32_t(objects.size())), [&](const cv::Range &range)
+	{
+		for (std::int32_t i = range.start; i < range.end; i++)
+			trackPoints(*objects[i]);
+	});
+}
+
+//
+// KLT of left and right points, check of epipolar constraint
+void StereoPointTracker::trackPoints(StereoPoints &points) const
+{
+	const cv::Size winSize(STEREO_TRACK_WIN_SIZE, STEREO_TRACK_WIN_SIZE);
+
+	std::vector<cv::Point2f> left, right;
+	std::vector<std::uint8_t> statusLeft, statusRight;
+	std::vector<std::float_t> err;
+
+	if (!points.left.empty())
+	{
+		cv::calcOpticalFlowPyrLK(m_prev_left, m_left, points.left, left, statusLeft, err, winSize, STEREO_TRACK_MAX_LEVEL);
+		cv::calcOpticalFlowPyrLK(m_prev_right, m_right, points.right, right, statusRight, err, winSize, STEREO_TRACK_MAX_LEVEL);
+	}
+
+	StereoPoints tracked;
+	for (std::size_t i = 0; i < left.size(); i++)
+	{
+		if (!statusLeft[i] || !statusRight[i])	continue;
+
+		// Row offset of the pair is kept (same epipolar line)
+		if (std::abs(left[i].y - right[i].y - points.dy[i]) > m_row_tolerance)	continue;
+		// Positive disparity
+		if (left[i].x <= right[i].x)	continue;
+
+		tracked.left.push_back(left[i]);
+		tracked.right.push_back(right[i]);
+		tracked.dy.push_back(points.dy[i]);
+	}
+
+	tracked.age = points.age + 1;
+	tracked.frame = m_frame;
+
+	points = tracked;
+}
+
+//
+// Tracked points of the object inside the box
+bool StereoPointTracker::getPoints(std::int32_t id, const cv::Rect &box, std::vector<cv::Point2f> &leftPts, std::vector<cv::Point2f> &rightPts) const
+{
+	leftPts.clear();
+	rightPts.clear();
+
+	auto it = m_objects.find(id);
+	if (it == m_objects.end())	return false;
+
+	const StereoPoints &points = it->second;
+	if (points.frame != m_frame || points.age > m_max_age)	return false;
+
+	for (std::size_t i = 0; i < points.left.size(); i++)
+	{
+		if (!box.contains(points.left[i]))	continue;
+
+		leftPts.push_back(points.left[i]);
+		rightPts.push_back(points.right[i]);
+	}
+
+	return std::int32_t(leftPts.size()) >= m_min_points;
+}
+
+//
+// Matched points of the current frame (after re-detection)
+void StereoPointTracker::setPoints(std::int32_t id, const std::vector<cv::Point2f> &leftPts, const std::vector<cv::Point2f> &rightPts)
+{
+	CV_Assert(leftPts.size() == rightPts.size());
+
+	StereoPoints &points = m_objects[id];
+	points.left = leftPts;
+	points.right = rightPts;
+
+	points.dy.resize(leftPts.size());
+	for (std::size_t i = 0; i < leftPts.size(); i++)
+		points.dy[i] = leftPts[i].y - rightPts[i].y;
+
+	points.age = 0;
+	points.frame = m_frame;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "calibration.h"
+
+using namespace calib;
+
+//
+// Fixed-point maps from calibration params
+bool StereoRectifier::init(StereoCalibrationReader &params)
+{
+	// Maps may be computed already (or loaded from the cache)
+	if (params.getMapType() != CV_16SC2 && !params.computeUndistortMap(CV_16SC2))
+	{
+		std::cout << "Rectify maps not received" << std::endl;
+		return false;
+	}
+
+	m_cache = params.getCache();
+	m_map1[0] = params.getMap1x();
+	m_map1[1] = params.getMap1y();
+	m_map2[0] = params.getMap2x();
+	m_map2[1] = params.getMap2y();
+
+	return isInitialized();
+}
+
+//
+// Stereo pair (left | right) -> rectified stereo pair
+void StereoRectifier::rectify(const cv::Mat &stereopair, cv::Mat &rectified) const
+{
+	CV_Assert(isInitialized());
+	CV_Assert(stereopair.data != rectified.data);
+
+	cv::Rect left(0, 0, stereopair.cols / 2, stereopair.rows);
+	cv::Rect right(stereopair.cols / 2, 0, stereopair.cols / 2, stereopair.rows);
+
+	rectified.create(stereopair.size(), stereopair.type());
+
+	cv::Mat leftRect = rectified(left), rightRect = rectified(right);
+	rectify(stereopair(left), stereopair(right), leftRect, rightRect);
+}
+void StereoRectifier::rectify(const cv::Mat &left, const cv::Mat &right, cv::Mat &leftRect, cv::Mat &rightRect) const
+{
+	CV_Assert(isInitialized());
+	CV_Assert(left.size() == m_map1[0].size() && right.size() == m_map2[0].size());
+
+	// Output views (may be parts of one stereo pair)
+	if (leftRect.size() != left.size() || leftRect.type() != left.type())
+		leftRect.create(left.size(), left.type());
+	if (rightRect.size() != right.size() || rightRect.type() != right.type())
+		rightRect.create(right.size(), right.type());
+
+	// Stripes of both views
+	const std::int32_t stripes = (left.rows + RECTIFY_STRIPE_ROWS - 1) / RECTIFY_STRIPE_ROWS;
+
+	cv::parallel_for_(cv::Range(0, 2 * stripes), [&](const cv::Range &range)
+	{
+		for (std::int32_t i = range.start; i < range.end; i++)
+		{
+			bool isLeft = i < stripes;
+			std::int32_t rowBegin = (i % stripes) * RECTIFY_STRIPE_ROWS;
+			std::int32_t rowEnd = std::min(rowBegin + RECTIFY_STRIPE_ROWS, left.rows);
+
+			const cv::Mat *maps = isLeft ? m_map1 : m_map2;
+			cv::Mat dst = (isLeft ? leftRect : rightRect).rowRange(rowBegin, rowEnd);
+
+			// Rows of the output depend only on the same rows of maps
+			cv::remap(isLeft ? left : right, dst, maps[0].rowRange(rowBegin, rowEnd), maps[1].rowRange(rowBegin, rowEnd),
+				cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+		}
+	});
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "TrackerCheckpoint.h"
+
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+
+
+TrackerCheckpoint::TrackerCheckpoint(std::string filename, std::int32_t period) :
+	m_filename(filename),
+	m_period(period > 0 ? period : CHECKPOINT_DEFAULT_PERIOD),
+	m_counter(0),
+	m_isPending(false),
+	m_isStopped(false),
+	m_sequence(0),
+	m_written(0)
+{
+	CV_Assert(!m_filename.empty());
+
+	m_thread = std::thread(&TrackerCheckpoint::run, this);
+}
+
+TrackerCheckpoint::~TrackerCheckpoint()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopped = true;
+	}
+	m_cond.notify_one();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+//
+// Pass the state to the writer every period-th frame.
+// If the previous state is not written yet, it is replaced
+void TrackerCheckpoint::update(const TrackingByMatching &tracker)
+{
+	if (++m_counter < m_period)	return;
+	m_counter = 0;
+
+	std::vector<std::uint8_t> state;
+	tracker.serialize(state);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_state.swap(state);
+		m_isPending = true;
+		m_sequence++;
+	}
+	m_cond.notify_one();
+}
+
+//
+// Write the state synchronously
+void TrackerCheckpoint::flush(const TrackingByMatching &tracker)
+{
+	std::vector<std::uint8_t> state;
+	tracker.serialize(state);
+
+	std::uint64_t sequence = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isPending = false;
+		m_counter = 0;
+		sequence = ++m_sequence;
+	}
+
+	write(state, sequence);
+}
+
+//
+// Background writer
+void TrackerCheckpoint::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_cond.wait(lock, [this] { return m_isPending || m_isStopped; });
+
+		if (m_isPending)
+		{
+			std::vector<std::uint8_t> state;
+			state.swap(m_state);
+			m_isPending = false;
+			std::uint64_t sequence = m_sequence;
+
+			// The tracking thread is not blocked while writing
+			lock.unlock();
+			write(state, sequence);
+			lock.lock();
+		}
+
+		if (m_isStopped && !m_isPending)	break;
+	}
+}
+
+//
+// The file is replaced only by completely written state
+bool TrackerCheckpoint::write(const std::vector<std::uint8_t> &state, std::uint64_t sequence)
+{
+	std::lock_guard<std::mutex> lock(m_file_mutex);
+	if (sequence <= m_written)	return true;
+
+	std::string tmpFilename = m_filename + ".tmp";
+
+	{
+		std::ofstream out(tmpFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+		{
+			std::cout << "Checkpoint: cannot open " << tmpFilename << std::endl;
+			return false;
+		}
+
+		out.write(reinterpret_cast<const char*>(state.data()), state.size());
+		if (!out.good())
+			return false;
+	}
+
+	// Atomic replacement: the old state stays until the new one is in place
+#ifdef _WIN32
+	if (!MoveFileExA(tmpFilename.c_str(), m_filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		return false;
+#else
+	if (std::rename(tmpFilename.c_str(), m_filename.c_str()) != 0)
+		return false;
+#endif
+
+	m_written = sequence;
+
+	return true;
+}
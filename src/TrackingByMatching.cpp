@@ -1,12 +1,18 @@
 #include "TrackingByMatching.h"
 
+// Binary format of the tracker state
+#define TRACKER_STATE_MAGIC   0x52544753	// "SGTR"
+#define TRACKER_STATE_VERSION 3
+// Last points of the path saved in the state (path is for drawing only)
+#define TRACKER_STATE_PATH_POINTS 32
+
 
 // Check for intersection of object areas
-bool checkCoverage(cv::Rect box1, cv::Rect box2);
+bool checkCoverage(cv::Rect box1, cv::Rect box2, std::double_t minCoverage);
 // Check distance between center points
-bool checkEucDistance(cv::Point cm1, cv::Point cm2);
+bool checkEucDistance(cv::Point cm1, cv::Point cm2, std::double_t maxDistance);
 // Area check
-bool checkAreas(std::uint32_t area1, std::uint32_t area2) { return (std::double_t(area1) / std::double_t(area2)) > TRACKER_MIN_AREAS_PERCENT; }
+bool checkAreas(std::uint32_t area1, std::uint32_t area2, std::double_t minPercent) { return (std::double_t(area1) / std::double_t(area2)) > minPercent; }
 
 // Returns the center point
 cv::Point2d calcCm(cv::Rect box) { return cv::Point2d(box.x + box.width / 2, box.y + box.height / 2); }
@@ -15,7 +21,152 @@ bool checkIds(std::int32_t class_id1, std::int32_t class_id2)					{ return class
 // Check objects classes names
 bool checkClassnames(std::string classname1, std::string classname2)		{ return classname1 == classname2; }
 // Check on the confidence of the detector for the object
-bool checkConfidence(std::double_t confidence1, std::double_t confidence2)  { return (confidence1 / confidence2) > TRACKER_MIN_CONFIDENCE_PERCENT; }
+bool checkConfidence(std::double_t confidence1, std::double_t confidence2, std::double_t minPercent)  { return (confidence1 / confidence2) > minPercent; }
+// Returns the median value (used for robust flow)
+std::double_t getMedian(std::vector<std::float_t> values);
+// Weighted sum of all checks
+std::double_t getMatchWeight(const TrackedObject &tObj, const cv::Rect &box, std::int32_t class_id, std::double_t confidence, const TrackerParams &params);
+// Similarity of appearance descriptors [0, 1]
+std::double_t getAppearanceSimilarity(const cv::Mat &appearance1, const cv::Mat &appearance2);
+
+// Writing and reading of the tracked object (tracker state)
+void writeObject(std::vector<std::uint8_t> &buffer, const TrackedObject &tObj);
+bool readObject(const std::vector<std::uint8_t> &buffer, std::size_t &offset, TrackedObject &tObj);
+
+// Parameter from YAML node (if exists)
+template<typename T> void readParam(const cv::FileNode &node, const std::string &name, T &value)
+{
+	if (!node[name].empty())
+		node[name] >> value;
+}
+
+// Plain values (native byte order)
+template<typename T> void writeValue(std::vector<std::uint8_t> &buffer, const T &value)
+{
+	const std::uint8_t *ptr = reinterpret_cast<const std::uint8_t*>(&value);
+	buffer.insert(buffer.end(), ptr, ptr + sizeof(T));
+}
+template<typename T> bool readValue(const std::vector<std::uint8_t> &buffer, std::size_t &offset, T &value)
+{
+	if (offset + sizeof(T) > buffer.size())	return false;
+
+	std::memcpy(&value, buffer.data() + offset, sizeof(T));
+	offset += sizeof(T);
+
+	return true;
+}
+
+
+
+//
+// Read parameters from YAML (missing values keep defaults)
+bool TrackerParams::read(const std::string &filename)
+{
+	cv::FileStorage fs(filename, cv::FileStorage::READ);
+	if (!fs.isOpened())
+	{
+		std::cout << "Tracker params not received: " << filename << std::endl;
+		return false;
+	}
+
+	read(fs.root());
+
+	return true;
+}
+void TrackerParams::read(const cv::FileNode &node)
+{
+	readParam(node, "minAreasPercent", minAreasPercent);
+	readParam(node, "minCoverage", minCoverage);
+	readParam(node, "maxEucDistance", maxEucDistance);
+	readParam(node, "minConfidencePercent", minConfidencePercent);
+
+	readParam(node, "checkWeight", checkWeight);
+	readParam(node, "weightArea", weightArea);
+	readParam(node, "weightCoverage", weightCoverage);
+	readParam(node, "weightEuc", weightEuc);
+	readParam(node, "weightConfidence", weightConfidence);
+	readParam(node, "weightClassId", weightClassId);
+
+	readParam(node, "highConfidence", highConfidence);
+	readParam(node, "lowConfidence", lowConfidence);
+	readParam(node, "distAlpha", distAlpha);
+
+	readParam(node, "minMissed", minMissed);
+	readParam(node, "maxMissed", maxMissed);
+	readParam(node, "minTracked", minTracked);
+
+	readParam(node, "flowMaxPoints", flowMaxPoints);
+	readParam(node, "flowMinPoints", flowMinPoints);
+	readParam(node, "flowQuality", flowQuality);
+	readParam(node, "flowMinDistance", flowMinDistance);
+	readParam(node, "flowWinSize", flowWinSize);
+	readParam(node, "flowMaxLevel", flowMaxLevel);
+	readParam(node, "flowMaxDeviation", flowMaxDeviation);
+	readParam(node, "flowMaxFrames", flowMaxFrames);
+
+	readParam(node, "appearanceAlpha", appearanceAlpha);
+	readParam(node, "appearanceUpdateRate", appearanceUpdateRate);
+	readParam(node, "weightAppearance", weightAppearance);
+	readParam(node, "minAppearance", minAppearance);
+
+	readParam(node, "lostMaxMissed", lostMaxMissed);
+	readParam(node, "lostMaxSize", lostMaxSize);
+}
+
+//
+// Write parameters to YAML
+bool TrackerParams::write(const std::string &filename) const
+{
+	cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+	if (!fs.isOpened())
+	{
+		std::cout << "Tracker params not saved: " << filename << std::endl;
+		return false;
+	}
+
+	write(fs);
+
+	return true;
+}
+void TrackerParams::write(cv::FileStorage &fs) const
+{
+	fs << "minAreasPercent" << minAreasPercent;
+	fs << "minCoverage" << minCoverage;
+	fs << "maxEucDistance" << maxEucDistance;
+	fs << "minConfidencePercent" << minConfidencePercent;
+
+	fs << "checkWeight" << checkWeight;
+	fs << "weightArea" << weightArea;
+	fs << "weightCoverage" << weightCoverage;
+	fs << "weightEuc" << weightEuc;
+	fs << "weightConfidence" << weightConfidence;
+	fs << "weightClassId" << weightClassId;
+
+	fs << "highConfidence" << highConfidence;
+	fs << "lowConfidence" << lowConfidence;
+	fs << "distAlpha" << distAlpha;
+
+	fs << "minMissed" << minMissed;
+	fs << "maxMissed" << maxMissed;
+	fs << "minTracked" << minTracked;
+
+	fs << "flowMaxPoints" << flowMaxPoints;
+	fs << "flowMinPoints" << flowMinPoints;
+	fs << "flowQuality" << flowQuality;
+	fs << "flowMinDistance" << flowMinDistance;
+	fs << "flowWinSize" << flowWinSize;
+	fs << "flowMaxLevel" << flowMaxLevel;
+	fs << "flowMaxDeviation" << flowMaxDeviation;
+	fs << "flowMaxFrames" << flowMaxFrames;
+
+	fs << "appearanceAlpha" << appearanceAlpha;
+	fs << "appearanceUpdateRate" << appearanceUpdateRate;
+	fs << "weightAppearance" << weightAppearance;
+	fs << "minAppearance" << minAppearance;
+
+	fs << "lostMaxMissed" << lostMaxMissed;
+	fs << "lostMaxSize" << lostMaxSize;
+}
 
 
 
@@ -24,60 +175,133 @@ bool checkConfidence(std::double_t confidence1, std::double_t confidence2)  { re
 //    1.       -  
 std::vector<TrackedObject> TrackingByMatching::track(const std::vector<DetectedObject> &detected_objects)
 {
+	return track(detected_objects, cv::Mat());
+}
+std::vector<TrackedObject> TrackingByMatching::track(const std::vector<DetectedObject> &detected_objects, const cv::Mat &frame)
+{
+	FrameCache cache(frame);
+
+	return track(detected_objects, cache);
+}
+std::vector<TrackedObject> TrackingByMatching::track(const std::vector<DetectedObject> &detected_objects, FrameCache &frame)
+{
+	std::int64_t start = m_profiling ? cv::getTickCount() : 0;
+	std::int64_t stage = start;
+
 	//   ,
 	//  
 	if (m_tracked_objects.empty())	initializationObjects(detected_objects);
 
+	// Grayscale pyramid of the frame (shared by all tracks)
+	buildPyramid(frame);
+	m_frame = frame.getFrame();
+
 	//     
 	//     ,
 	//    
-	for (auto &tObj : m_tracked_objects)	
+	for (auto &tObj : m_tracked_objects)
+	{
+		if (tObj.distAge >= 0)
+			tObj.distAge++;
+
+		// The box moved by optical flow is not considered missed,
+		// but only a limited number of frames in a row
+		if (propagateObject(tObj) && tObj.flowed <= m_params.flowMaxFrames)
+			continue;
+
 		tObj.missed++;
+	}
 
-	for (auto dObj : detected_objects)
+	// First pass: high-confidence detections
+	for (auto &dObj : detected_objects)
 	{
-		bool isMatch = false;
-		for (auto &tObj : m_tracked_objects)
-		{
-			bool isAreas	  = checkAreas(tObj.box.area(), dObj.box.area());
-			bool isCoverage	  = checkCoverage(tObj.box, dObj.box);
-			bool isEuc		  = checkEucDistance(tObj.cm, calcCm(dObj.box));
-			bool isId		  = checkIds(tObj.class_id, dObj.class_id);
-			bool isConfidence = checkConfidence(tObj.confidence, dObj.confidence);
-
-			
-			if ( isAreas *		TRACKER_WEIGHT_AREA + 
-				 isCoverage *	TRACKER_WEIGHT_COVERAGE +
-				 isEuc *		TRACKER_WEIGHT_EUC +
-				 isId *			TRACKER_WEIGHT_CLASS_ID +
-				 isConfidence * TRACKER_WEIGHT_CONFIDENCE
-	             > TRAKER_CHECK_WEIGHT)
-			{
-				updateTrObject(dObj, tObj);
+		if (dObj.confidence < m_params.highConfidence)	continue;
 
-				isMatch = true;
-				break;
-			}
-		}
+		// Computed only if the match is ambiguous
+		// or the object is compared with lost objects
+		cv::Mat appearance;
 
-		if (!isMatch)
+		std::int32_t idx = findMatch(dObj, appearance);
+		if (idx != -1)
+			updateTrObject(dObj, m_tracked_objects[idx], appearance);
+		else if (!reidentifyObject(dObj, appearance))
 			addTrObject(dObj);
 	}
 
+	// Second pass: low-confidence detections.
+	// Only extend tracks not updated on this frame, never create new ones
+	for (auto &dObj : detected_objects)
+	{
+		if (dObj.confidence >= m_params.highConfidence || dObj.confidence < m_params.lowConfidence)	continue;
+
+		cv::Mat appearance;
+
+		std::int32_t idx = findMatch(dObj, appearance, true);
+		if (idx != -1)
+			updateTrObject(dObj, m_tracked_objects[idx], appearance);
+	}
+
+	profileStage(m_profile.match, stage);
+
 	checkRepeatObjects();
+	profileStage(m_profile.repeat, stage);
 
 	checkMissed();
+	profileStage(m_profile.missed, stage);
+
 	checkTracked();
+	profileStage(m_profile.tracked, stage);
+
+	checkLost();
+
+	// Points for propagation on the next frame
+	for (auto &tObj : m_tracked_objects)
+		seedFlowPoints(tObj);
+
+	m_frame.release();
+
+	if (m_profiling)
+	{
+		m_profile.track += cv::getTickCount() - start;
+		m_profile.frames++;
+		m_profile.objects += m_tracked_objects.size();
+	}
 
 	return m_tracked_objects;
 }
 
+//
+// Distances and positions computed outside of the tracker
+void TrackingByMatching::updateDistances(const std::vector<TrackedObject> &objects)
+{
+	for (auto &obj : objects)
+	{
+		for (auto &tObj : m_tracked_objects)
+		{
+			if (tObj.id_int != obj.id_int)	continue;
+
+			tObj.distance = obj.distance;
+			tObj.distAvg = obj.distAvg;
+			tObj.distAge = obj.distAge;
+			tObj.position = obj.position;
+			tObj.velocity = obj.velocity;
+			tObj.positionTime = obj.positionTime;
+			tObj.positions = obj.positions;
+			tObj.ttc = obj.ttc;
+			break;
+		}
+	}
+}
+
 // 
 // Generate the initial object vector.
 void TrackingByMatching::initializationObjects(const std::vector<DetectedObject> &detected_objects)
 {
 	for (auto &dObj : detected_objects)
-		addTrObject(dObj);
+	{
+		if (dObj.confidence >= m_params.highConfidence)
+			addTrObject(dObj);
+	}
 }
 
 // --TODO
@@ -105,18 +329,7 @@ void TrackingByMatching::checkRepeatObjects()
 			if (tObjSrc.id_int == tObjVer.id_int)	
 				continue;
 
-			bool isAreas	  = checkAreas(tObjSrc.box.area(), tObjVer.box.area());
-			bool isCoverage   = checkCoverage(tObjSrc.box, tObjVer.box);
-			bool isEuc		  = checkEucDistance(tObjSrc.cm, tObjVer.cm);
-			bool isId		  = checkIds(tObjSrc.class_id, tObjVer.class_id);
-			bool isConfidence = checkConfidence(tObjSrc.confidence, tObjVer.confidence);
-
-			if (isAreas *		TRACKER_WEIGHT_AREA +
-				isCoverage *	TRACKER_WEIGHT_COVERAGE +
-				isEuc *			TRACKER_WEIGHT_EUC +
-				isId *			TRACKER_WEIGHT_CLASS_ID +
-				isConfidence *	TRACKER_WEIGHT_CONFIDENCE
-				 > TRAKER_CHECK_WEIGHT)
+			if (getMatchWeight(tObjSrc, tObjVer.box, tObjVer.class_id, tObjVer.confidence, m_params) > m_params.checkWeight)
 			{
 				//std::cout << "ver: " << tObjVer.id_int << " ," << tObjVer.id_ext << "," << tObjVer.classname << std::endl
 				//	<< "src: " << tObjSrc.id_int << ", " << tObjSrc.id_ext << ", " << tObjSrc.classname << "\n" << std::endl;
@@ -138,6 +351,55 @@ void TrackingByMatching::checkRepeatObjects()
 		eraseObject(id);
 }
 
+//
+// Find the tracked object for the detected object.
+// If several objects pass the threshold, appearance is compared.
+// Objects already updated by detection on this frame may be skipped
+std::int32_t TrackingByMatching::findMatch(const DetectedObject &dObj, cv::Mat &appearance, bool onlyNotUpdated)
+{
+	std::vector<std::int32_t> candidates;
+	std::vector<std::double_t> weights;
+
+	for (std::int32_t i = 0; i < std::int32_t(m_tracked_objects.size()); i++)
+	{
+		if (onlyNotUpdated && m_tracked_objects[i].missed == 0 && m_tracked_objects[i].flowed == 0)
+			continue;
+
+		std::double_t weight = getMatchWeight(m_tracked_objects[i], dObj.box, dObj.class_id, dObj.confidence, m_params);
+		if (weight > m_params.checkWeight)
+		{
+			candidates.push_back(i);
+			weights.push_back(weight);
+		}
+	}
+
+	if (candidates.empty())			return -1;
+	if (candidates.size() == 1)		return candidates[0];
+
+	// Ambiguous match
+	if (appearance.empty())
+		appearance = computeAppearance(dObj.box);
+
+	std::int32_t bestIdx = -1;
+	std::double_t bestWeight = 0.0;
+	for (std::size_t i = 0; i < candidates.size(); i++)
+	{
+		TrackedObject &tObj = m_tracked_objects[candidates[i]];
+
+		if (tObj.appearance.empty() && !appearance.empty())
+			tObj.appearance = computeAppearance(tObj.box);
+
+		std::double_t weight = weights[i] + m_params.weightAppearance * getAppearanceSimilarity(tObj.appearance, appearance);
+		if (weight > bestWeight)
+		{
+			bestWeight = weight;
+			bestIdx = candidates[i];
+		}
+	}
+
+	return bestIdx;
+}
+
 //
 // Add new tracked object
 void TrackingByMatching::addTrObject(const DetectedObject &dObj)
@@ -151,7 +413,7 @@ void TrackingByMatching::addTrObject(const DetectedObject &dObj)
 
 //
 // Update tracked object fields by detected object
-void TrackingByMatching::updateTrObject(const DetectedObject &dObj, TrackedObject &tObj)
+void TrackingByMatching::updateTrObject(const DetectedObject &dObj, TrackedObject &tObj, cv::Mat appearance)
 {
 	tObj.class_id = dObj.class_id;
 	tObj.classname = dObj.classname;
@@ -163,9 +425,18 @@ void TrackingByMatching::updateTrObject(const DetectedObject &dObj, TrackedObjec
 
 	tObj.tracked++;
 	tObj.missed = 0;
+	tObj.flowed = 0;
 
 	tObj.cm = calcCm(tObj.box);
 	tObj.objPath.push_back(tObj.cm);
+
+	// Appearance of confirmed objects is refreshed periodically
+	// (for re-identification after loss)
+	if (appearance.empty() && tObj.id_ext != -1 &&
+		(tObj.appearance.empty() || tObj.tracked % std::max(m_params.appearanceUpdateRate, 1) == 0))
+		appearance = computeAppearance(tObj.box);
+
+	updateAppearance(tObj, appearance);
 }
 // Update tracked object fields by tracked object
 void TrackingByMatching::updateTrObject(const TrackedObject &tObj1, TrackedObject &tObj2)
@@ -175,6 +446,7 @@ void TrackingByMatching::updateTrObject(const TrackedObject &tObj1, TrackedObjec
 
 	tObj2.tracked++;
 	tObj2.missed = 0;
+	tObj2.flowed = 0;
 
 	tObj2.cm = calcCm(tObj2.box);
 	tObj2.objPath.push_back(tObj2.cm);
@@ -185,9 +457,16 @@ void TrackingByMatching::updateTrObject(const TrackedObject &tObj1, TrackedObjec
 void TrackingByMatching::checkTracked()
 {
 	for (auto &tObj : m_tracked_objects)
-		if (tObj.id_ext == -1 && tObj.tracked > TRACKER_MIN_TRACKED)
+	{
+		if (tObj.id_ext == -1 && tObj.tracked > m_params.minTracked)
+		{
 			tObj.id_ext = createUniqueExtId();
 
+			if (tObj.appearance.empty())
+				tObj.appearance = computeAppearance(tObj.box);
+		}
+	}
+
 	//     
 	std::sort(m_tracked_objects.begin(), m_tracked_objects.end(), [](const TrackedObject &tObj1, const TrackedObject &tObj2) -> bool
 	{
@@ -208,10 +487,22 @@ void TrackingByMatching::checkMissed()
 {
 	std::vector<std::int32_t> idsInt;
 
-	for (auto tObj : m_tracked_objects)
-		if (tObj.missed > TRACKER_MAX_MISSED)
+	for (auto &tObj : m_tracked_objects)
+	{
+		if (tObj.missed > m_params.maxMissed)
+		{
 			idsInt.push_back(tObj.id_int);
 
+			// Confirmed object may be re-identified later
+			if (tObj.id_ext != -1 && !tObj.appearance.empty())
+			{
+				m_lost_objects.push_back(tObj);
+				m_lost_objects.back().flowPts.clear();
+				m_lost_objects.back().objPath.clear();
+			}
+		}
+	}
+
 	for (auto idInt : idsInt)
 		eraseObject(idInt);
 }
@@ -235,20 +526,334 @@ void TrackingByMatching::eraseObject(std::int32_t id_int)
 	m_tracked_objects.erase(m_tracked_objects.begin() + counter);
 }
 
+//
+// Take grayscale pyramid of the current frame.
+// The pyramid of the previous frame is kept for optical flow
+void TrackingByMatching::buildPyramid(FrameCache &frame)
+{
+	std::swap(m_prev_pyramid, m_pyramid);
+
+	if (frame.empty())
+	{
+		m_pyramid.clear();
+		return;
+	}
+
+	m_frame_size = frame.getSize();
+
+	// Levels are shared with the cache (headers only)
+	m_pyramid = frame.getPyramid(m_params.flowWinSize, m_params.flowMaxLevel);
+}
+
+//
+// Move and scale the box by median flow of its points
+bool TrackingByMatching::propagateObject(TrackedObject &tObj)
+{
+	if (tObj.id_ext == -1 || tObj.flowPts.size() < std::size_t(m_params.flowMinPoints))	return false;
+	if (m_pyramid.empty() || m_prev_pyramid.size() != m_pyramid.size())			return false;
+	if (m_prev_pyramid[0].size() != m_pyramid[0].size())							return false;
+
+	std::vector<cv::Point2f> nextPts;
+	std::vector<std::uint8_t> status;
+	std::vector<std::float_t> err;
+	cv::calcOpticalFlowPyrLK(m_prev_pyramid, m_pyramid, tObj.flowPts, nextPts, status, err,
+		cv::Size(m_params.flowWinSize, m_params.flowWinSize), m_params.flowMaxLevel);
+
+	// Keep successfully tracked points
+	std::vector<cv::Point2f> prevPts, currPts;
+	std::vector<std::float_t> dx, dy;
+	for (std::size_t i = 0; i < status.size(); i++)
+	{
+		if (!status[i])	continue;
+
+		prevPts.push_back(tObj.flowPts[i]);
+		currPts.push_back(nextPts[i]);
+		dx.push_back(nextPts[i].x - tObj.flowPts[i].x);
+		dy.push_back(nextPts[i].y - tObj.flowPts[i].y);
+	}
+
+	if (prevPts.size() < std::size_t(m_params.flowMinPoints))
+	{
+		tObj.flowPts.clear();
+		return false;
+	}
+
+	// Robust displacement
+	std::double_t medDx = getMedian(dx);
+	std::double_t medDy = getMedian(dy);
+
+	// Robust scale by ratio of distances between point pairs
+	std::vector<std::float_t> ratios;
+	for (std::size_t i = 0; i < prevPts.size(); i++)
+	{
+		for (std::size_t j = i + 1; j < prevPts.size(); j++)
+		{
+			std::double_t distPrev = cv::norm(prevPts[i] - prevPts[j]);
+			if (distPrev < 1.0)	continue;
+
+			ratios.push_back(std::float_t(cv::norm(currPts[i] - currPts[j]) / distPrev));
+		}
+	}
+	std::double_t scale = ratios.empty() ? 1.0 : getMedian(ratios);
+
+	// Outliers are not used on the next frame
+	tObj.flowPts.clear();
+	for (std::size_t i = 0; i < currPts.size(); i++)
+		if (std::abs(dx[i] - medDx) < m_params.flowMaxDeviation && std::abs(dy[i] - medDy) < m_params.flowMaxDeviation)
+			tObj.flowPts.push_back(currPts[i]);
+
+	// Move and scale the box relative to its center
+	cv::Point2d center(tObj.box.x + tObj.box.width / 2.0 + medDx, tObj.box.y + tObj.box.height / 2.0 + medDy);
+	cv::Size2d size(tObj.box.width * scale, tObj.box.height * scale);
+
+	cv::Rect box(cvRound(center.x - size.width / 2), cvRound(center.y - size.height / 2), cvRound(size.width), cvRound(size.height));
+	box &= cv::Rect(cv::Point(0, 0), m_frame_size);
+	if (box.area() == 0)
+	{
+		tObj.flowPts.clear();
+		return false;
+	}
+
+	tObj.box = box;
+	tObj.cm = calcCm(tObj.box);
+	tObj.objPath.push_back(tObj.cm);
+	tObj.flowed++;
+
+	return true;
+}
+
+//
+// Seed points inside the box for optical flow.
+// Points are re-seeded after detector update or if few points left
+void TrackingByMatching::seedFlowPoints(TrackedObject &tObj)
+{
+	if (m_pyramid.empty() || tObj.id_ext == -1)	return;
+	if (tObj.flowed > 0 && tObj.flowPts.size() >= std::size_t(m_params.flowMinPoints))	return;
+
+	tObj.flowPts.clear();
+
+	cv::Rect roi = tObj.box & cv::Rect(cv::Point(0, 0), m_frame_size);
+	if (roi.area() == 0)	return;
+
+	cv::goodFeaturesToTrack(m_pyramid[0](roi), tObj.flowPts, m_params.flowMaxPoints, m_params.flowQuality, m_params.flowMinDistance);
+
+	for (auto &pt : tObj.flowPts)
+		pt += cv::Point2f(std::float_t(roi.x), std::float_t(roi.y));
+}
+
+//
+// Appearance descriptor of the box on the current frame
+// (hue-saturation histogram, L1 normalized)
+cv::Mat TrackingByMatching::computeAppearance(const cv::Rect &box) const
+{
+	if (m_frame.empty() || m_frame.channels() != 3)	return cv::Mat();
+
+	cv::Rect roi = box & cv::Rect(0, 0, m_frame.cols, m_frame.rows);
+	if (roi.area() == 0)	return cv::Mat();
+
+	cv::Mat hsv;
+	cv::cvtColor(m_frame(roi), hsv, cv::COLOR_BGR2HSV);
+
+	cv::Mat hist;
+	int channels[] = { 0, 1 };
+	int histSize[] = { TRACKER_APPEARANCE_H_BINS, TRACKER_APPEARANCE_S_BINS };
+	float hRange[] = { 0, 180 };
+	float sRange[] = { 0, 256 };
+	const float* ranges[] = { hRange, sRange };
+	cv::calcHist(&hsv, 1, channels, cv::Mat(), hist, 2, histSize, ranges);
+
+	cv::normalize(hist, hist, 1.0, 0.0, cv::NORM_L1);
+
+	return hist;
+}
+
+//
+// Exponential moving average of the appearance descriptor
+void TrackingByMatching::updateAppearance(TrackedObject &tObj, const cv::Mat &appearance)
+{
+	if (appearance.empty())	return;
+
+	if (tObj.appearance.empty())
+		tObj.appearance = appearance.clone();
+	else
+		tObj.appearance = (1.0 - m_params.appearanceAlpha) * tObj.appearance + m_params.appearanceAlpha * appearance;
+}
+
+//
+// Search the detected object among lost objects.
+// If found, the object is restored with its external id
+bool TrackingByMatching::reidentifyObject(const DetectedObject &dObj, cv::Mat &appearance)
+{
+	bool isCandidate = false;
+	for (auto &lObj : m_lost_objects)
+		if (checkIds(lObj.class_id, dObj.class_id))
+			isCandidate = true;
+
+	if (!isCandidate)	return false;
+
+	if (appearance.empty())
+		appearance = computeAppearance(dObj.box);
+	if (appearance.empty())
+		return false;
+
+	std::int32_t bestIdx = -1;
+	std::double_t bestSimilarity = m_params.minAppearance;
+	for (std::int32_t i = 0; i < std::int32_t(m_lost_objects.size()); i++)
+	{
+		if (!checkIds(m_lost_objects[i].class_id, dObj.class_id))	continue;
+
+		std::double_t similarity = getAppearanceSimilarity(m_lost_objects[i].appearance, appearance);
+		if (similarity > bestSimilarity)
+		{
+			bestSimilarity = similarity;
+			bestIdx = i;
+		}
+	}
+
+	if (bestIdx == -1)	return false;
+
+	TrackedObject tObj = m_lost_objects[bestIdx];
+	m_lost_objects.erase(m_lost_objects.begin() + bestIdx);
+
+	updateTrObject(dObj, tObj, appearance);
+	m_tracked_objects.push_back(tObj);
+
+	return true;
+}
+
+//
+// Lost objects are kept for a limited number of frames
+void TrackingByMatching::checkLost()
+{
+	for (auto &lObj : m_lost_objects)
+		lObj.missed++;
+
+	std::int32_t maxMissed = m_params.lostMaxMissed;
+	m_lost_objects.erase(std::remove_if(m_lost_objects.begin(), m_lost_objects.end(), [maxMissed](const TrackedObject &lObj)
+	{
+		return lObj.missed > maxMissed;
+	}), m_lost_objects.end());
+
+	// The oldest objects are deleted first
+	std::size_t maxSize = std::max(m_params.lostMaxSize, 0);
+	if (m_lost_objects.size() > maxSize)
+		m_lost_objects.erase(m_lost_objects.begin(), m_lost_objects.end() - maxSize);
+}
+
+//
+// Tracker state: ids, tracked and lost objects.
+// Optical flow points and pyramids are not saved (frame dependent)
+void TrackingByMatching::serialize(std::vector<std::uint8_t> &buffer) const
+{
+	buffer.clear();
+
+	writeValue(buffer, std::uint32_t(TRACKER_STATE_MAGIC));
+	writeValue(buffer, std::uint32_t(TRACKER_STATE_VERSION));
+
+	// Ids of the shared allocator are not counted by the instance
+	writeValue(buffer, m_id_allocator ? m_id_allocator->getExtId() : m_id_ext);
+	writeValue(buffer, m_id_allocator ? m_id_allocator->getIntId() : m_id_int);
+
+	writeValue(buffer, std::uint32_t(m_tracked_objects.size()));
+	for (auto &tObj : m_tracked_objects)
+		writeObject(buffer, tObj);
+
+	writeValue(buffer, std::uint32_t(m_lost_objects.size()));
+	for (auto &lObj : m_lost_objects)
+		writeObject(buffer, lObj);
+}
+bool TrackingByMatching::deserialize(const std::vector<std::uint8_t> &buffer)
+{
+	std::size_t offset = 0;
+	std::uint32_t magic = 0, version = 0;
+
+	if (!readValue(buffer, offset, magic) || magic != TRACKER_STATE_MAGIC)	return false;
+	if (!readValue(buffer, offset, version) || version != TRACKER_STATE_VERSION)	return false;
+
+	std::int32_t idExt = 0, idInt = 0;
+	if (!readValue(buffer, offset, idExt) || !readValue(buffer, offset, idInt))	return false;
+
+	std::vector<TrackedObject> trackedObjects, lostObjects;
+	for (auto objects : { &trackedObjects, &lostObjects })
+	{
+		std::uint32_t size = 0;
+		if (!readValue(buffer, offset, size))	return false;
+
+		for (std::uint32_t i = 0; i < size; i++)
+		{
+			TrackedObject tObj;
+			if (!readObject(buffer, offset, tObj))	return false;
+
+			objects->push_back(tObj);
+		}
+	}
+
+	// New ids must not repeat the ids of restored objects
+	for (auto objects : { &trackedObjects, &lostObjects })
+	{
+		for (auto &tObj : *objects)
+		{
+			idExt = std::max(idExt, tObj.id_ext + 1);
+			idInt = std::max(idInt, tObj.id_int + 1);
+		}
+	}
+
+	m_tracked_objects.swap(trackedObjects);
+	m_lost_objects.swap(lostObjects);
+
+	m_id_ext = idExt;
+	m_id_int = idInt;
+	if (m_id_allocator)
+		m_id_allocator->reserveIds(idExt, idInt);
+
+	m_pyramid.clear();
+	m_prev_pyramid.clear();
+
+	return true;
+}
+
+//
+// Save / load the tracker state
+bool TrackingByMatching::save(const std::string &filename) const
+{
+	std::vector<std::uint8_t> buffer;
+	serialize(buffer);
+
+	std::ofstream out(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.is_open())	return false;
+
+	out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+
+	return out.good();
+}
+bool TrackingByMatching::load(const std::string &filename)
+{
+	std::ifstream in(filename, std::ios::in | std::ios::binary);
+	if (!in.is_open())	return false;
+
+	std::vector<std::uint8_t> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	return deserialize(buffer);
+}
+
 //
 // Returns a unique external id
-std::int32_t TrackingByMatching::createUniqueExtId() const
+std::int32_t TrackingByMatching::createUniqueExtId()
 {
-	static std::int32_t id = 0;
-	return id++;
+	if (m_id_allocator)
+		return m_id_allocator->createExtId();
+
+	return m_id_ext++;
 }
 
 //
 // Returns a unique internal id
-std::int32_t TrackingByMatching::createUniqueIntId() const
+std::int32_t TrackingByMatching::createUniqueIntId()
 {
-	static std::int32_t id = 0;
-	return id++;
+	if (m_id_allocator)
+		return m_id_allocator->createIntId();
+
+	return m_id_int++;
 }
 
 
@@ -293,11 +898,148 @@ std::double_t getAreasCoverage(cv::Rect box1, cv::Rect box2)
 
 // Hit test and crossing percentage
 // If above a certain threshold, the test passed
-bool checkCoverage(cv::Rect box1, cv::Rect box2) { return isHit(box1, box2) && (getAreasCoverage(box1, box2) > TRACKER_MIN_COVERAGE); }
+bool checkCoverage(cv::Rect box1, cv::Rect box2, std::double_t minCoverage) { return isHit(box1, box2) && (getAreasCoverage(box1, box2) > minCoverage); }
 
 
 std::double_t getEuclideanDistance(cv::Point pt1, cv::Point pt2) { return sqrt(pow(pt1.x - pt2.x, 2) - pow((pt1.y - pt2.y), 2)); }
 
 // Check for maximum Euclidean distance
 // If more than the threshold, then false
-bool checkEucDistance(cv::Point cm1, cv::Point cm2) { return (getEuclideanDistance(cm1, cm2) < TRACKER_MAX_EUC_DISTANCE); }
\ No newline at end of file
+bool checkEucDistance(cv::Point cm1, cv::Point cm2, std::double_t maxDistance) { return (getEuclideanDistance(cm1, cm2) < maxDistance); }
+
+
+//
+// Returns the median value
+std::double_t getMedian(std::vector<std::float_t> values)
+{
+	if (values.empty())	return 0.0;
+
+	auto middle = values.begin() + values.size() / 2;
+	std::nth_element(values.begin(), middle, values.end());
+
+	return *middle;
+}
+
+//
+// Weighted sum of all checks
+std::double_t getMatchWeight(const TrackedObject &tObj, const cv::Rect &box, std::int32_t class_id, std::double_t confidence, const TrackerParams &params)
+{
+	bool isAreas	  = checkAreas(tObj.box.area(), box.area(), params.minAreasPercent);
+	bool isCoverage	  = checkCoverage(tObj.box, box, params.minCoverage);
+	bool isEuc		  = checkEucDistance(tObj.cm, calcCm(box), params.maxEucDistance);
+	bool isId		  = checkIds(tObj.class_id, class_id);
+	bool isConfidence = checkConfidence(tObj.confidence, confidence, params.minConfidencePercent);
+
+	return isAreas *		params.weightArea +
+		   isCoverage *		params.weightCoverage +
+		   isEuc *			params.weightEuc +
+		   isId *			params.weightClassId +
+		   isConfidence *	params.weightConfidence;
+}
+
+//
+// Similarity of appearance descriptors (1 - Bhattacharyya distance)
+std::double_t getAppearanceSimilarity(const cv::Mat &appearance1, const cv::Mat &appearance2)
+{
+	if (appearance1.empty() || appearance2.empty())	return 0.0;
+
+	return 1.0 - cv::compareHist(appearance1, appearance2, cv::HISTCMP_BHATTACHARYYA);
+}
+
+//
+// Tracked object fields in binary format
+void writeObject(std::vector<std::uint8_t> &buffer, const TrackedObject &tObj)
+{
+	writeValue(buffer, tObj.id_ext);
+	writeValue(buffer, tObj.id_int);
+	writeValue(buffer, tObj.class_id);
+
+	writeValue(buffer, std::uint32_t(tObj.classname.size()));
+	buffer.insert(buffer.end(), tObj.classname.begin(), tObj.classname.end());
+
+	writeValue(buffer, tObj.confidence);
+	writeValue(buffer, tObj.box);
+	writeValue(buffer, tObj.cm);
+	writeValue(buffer, tObj.cmPrev);
+	writeValue(buffer, tObj.distance);
+	writeValue(buffer, tObj.distAvg);
+	writeValue(buffer, tObj.distAge);
+	writeValue(buffer, tObj.position);
+	writeValue(buffer, tObj.velocity);
+	writeValue(buffer, tObj.positionTime);
+	writeValue(buffer, tObj.positions);
+	writeValue(buffer, tObj.ttc);
+	writeValue(buffer, tObj.missed);
+	writeValue(buffer, tObj.tracked);
+
+	// Appearance (CV_32F histogram)
+	cv::Mat appearance;
+	if (!tObj.appearance.empty())
+		tObj.appearance.convertTo(appearance, CV_32F);
+
+	writeValue(buffer, std::int32_t(appearance.rows));
+	writeValue(buffer, std::int32_t(appearance.cols));
+	for (std::int32_t i = 0; i < appearance.rows; i++)
+		for (std::int32_t j = 0; j < appearance.cols; j++)
+			writeValue(buffer, appearance.at<std::float_t>(i, j));
+
+	// Only the tail of the path (the state stays compact on long tracks)
+	std::size_t pathBegin = tObj.objPath.size() - std::min<std::size_t>(tObj.objPath.size(), TRACKER_STATE_PATH_POINTS);
+	writeValue(buffer, std::uint32_t(tObj.objPath.size() - pathBegin));
+	for (std::size_t i = pathBegin; i < tObj.objPath.size(); i++)
+		writeValue(buffer, tObj.objPath[i]);
+}
+bool readObject(const std::vector<std::uint8_t> &buffer, std::size_t &offset, TrackedObject &tObj)
+{
+	std::uint32_t size = 0;
+
+	if (!readValue(buffer, offset, tObj.id_ext) ||
+		!readValue(buffer, offset, tObj.id_int) ||
+		!readValue(buffer, offset, tObj.class_id))
+		return false;
+
+	if (!readValue(buffer, offset, size) || offset + size > buffer.size())
+		return false;
+	tObj.classname.assign(buffer.begin() + offset, buffer.begin() + offset + size);
+	offset += size;
+
+	if (!readValue(buffer, offset, tObj.confidence) ||
+		!readValue(buffer, offset, tObj.box) ||
+		!readValue(buffer, offset, tObj.cm) ||
+		!readValue(buffer, offset, tObj.cmPrev) ||
+		!readValue(buffer, offset, tObj.distance) ||
+		!readValue(buffer, offset, tObj.distAvg) ||
+		!readValue(buffer, offset, tObj.distAge) ||
+		!readValue(buffer, offset, tObj.position) ||
+		!readValue(buffer, offset, tObj.velocity) ||
+		!readValue(buffer, offset, tObj.positionTime) ||
+		!readValue(buffer, offset, tObj.positions) ||
+		!readValue(buffer, offset, tObj.ttc) ||
+		!readValue(buffer, offset, tObj.missed) ||
+		!readValue(buffer, offset, tObj.tracked))
+		return false;
+
+	std::int32_t rows = 0, cols = 0;
+	if (!readValue(buffer, offset, rows) || !readValue(buffer, offset, cols))
+		return false;
+	if (rows < 0 || cols < 0 || offset + std::size_t(rows) * cols * sizeof(std::float_t) > buffer.size())
+		return false;
+
+	tObj.appearance.release();
+	if (rows > 0 && cols > 0)
+	{
+		tObj.appearance.create(rows, cols, CV_32F);
+		for (std::int32_t i = 0; i < rows; i++)
+			for (std::int32_t j = 0; j < cols; j++)
+				readValue(buffer, offset, tObj.appearance.at<std::float_t>(i, j));
+	}
+
+	if (!readValue(buffer, offset, size) || offset + std::size_t(size) * sizeof(cv::Point2d) > buffer.size())
+		return false;
+
+	tObj.objPath.resize(size);
+	for (auto &pt : tObj.objPath)
+		readValue(buffer, offset, pt);
+
+	return true;
+}
\ No newline at end of file
@@ -70,6 +70,20 @@ bool Calibration::getCorners(const cv::Mat& image, std::vector<cv::Point2f>& cor
 	return true;
 }
 
+//
+// Corners of all images in parallel (flags are bytes: vector<bool> is not safe to write from threads)
+void Calibration::getCorners(const std::vector<cv::Mat>& images, std::vector<std::vector<cv::Point2f>>& corners, std::vector<std::uint8_t>& isFound)
+{
+	corners.assign(images.size(), std::vector<cv::Point2f>());
+	isFound.assign(images.size(), 0);
+
+	cv::parallel_for_(cv::Range(0, std::int32_t(images.size())), [&](const cv::Range &range)
+	{
+		for (std::int32_t i = range.start; i < range.end; i++)
+			isFound[i] = getCorners(images[i], corners[i]);
+	});
+}
+
 
 
 std::double_t calib::calculateDistance(std::double_t baselineMetres, std::double_t focalLenght, std::double_t disparity)